@@ -1,15 +1,29 @@
 #include "devices/disk.h"
 #include <ctype.h>
 #include <debug.h>
+#include <round.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
+#include "devices/iosched.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
-   controller.  It attempts to comply to [ATA-3]. */
+   controller.  It attempts to comply to [ATA-3].
+
+   Disk accesses are expressed as requests (struct disk_request)
+   that are queued on the channel of the target disk.  Each
+   channel has a driver thread that takes requests off its queue
+   and carries them out back-to-back, so that any number of
+   callers may have requests in flight and the two channels
+   operate in parallel.  The I/O scheduler (iosched.c) decides
+   the order in which each channel's requests are served. */
 
 /* ATA command block port addresses. */
 #define reg_data(CHANNEL) ((CHANNEL)->reg_base + 0)     /* Data. */
@@ -47,16 +61,30 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_SECTOR_EXT 0x24        /* READ SECTOR EXT (LBA48). */
+#define CMD_WRITE_SECTOR_EXT 0x34       /* WRITE SECTOR EXT (LBA48). */
+
+/* Sectors addressable with 28-bit LBA.  Sectors beyond this are
+   accessed with the LBA48 commands, if the disk supports them. */
+#define LBA28_SECTORS (1UL << 28)
+
+/* Maximum number of sectors transferred by a single command.
+   A sector count register value of 0 means 256 sectors. */
+#define MAX_XFER_SECTORS 256
 
-/* An ATA device. */
+/* A disk: an ATA device or a disk provided by another driver. */
 struct disk 
   {
     char name[8];               /* Name, e.g. "hd0:1". */
+    const struct disk_operations *ops;  /* Driver operations. */
+    void *aux;                  /* Driver's private data. */
+    disk_sector_t capacity;     /* Capacity in sectors. */
+
+    /* ATA devices only. */
     struct channel *channel;    /* Channel disk is on. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
-
     bool is_ata;                /* 1=This device is an ATA disk. */
-    disk_sector_t capacity;     /* Capacity in sectors (if is_ata). */
+    bool lba48;                 /* Supports 48-bit LBA? */
 
     long long read_cnt;         /* Number of sectors read. */
     long long write_cnt;        /* Number of sectors written. */
@@ -70,7 +98,10 @@ struct channel
     uint16_t reg_base;          /* Base I/O port. */
     uint8_t irq;                /* Interrupt in use. */
 
-    struct lock lock;           /* Must acquire to access the controller. */
+    struct lock lock;           /* Protects the request queue. */
+    struct condition queue_not_empty;   /* Signaled when queue grows. */
+    struct iosched_queue queue; /* Pending requests. */
+
     bool expecting_interrupt;   /* True if an interrupt is expected, false if
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
@@ -82,11 +113,41 @@ struct channel
 #define CHANNEL_CNT 2
 static struct channel channels[CHANNEL_CNT];
 
+/* Disks provided by other drivers. */
+#define OTHER_DISK_CNT 4
+static struct disk other_disks[OTHER_DISK_CNT];
+static size_t other_disk_cnt;
+
+/* The disk filling each role, indexed the same way as the ATA
+   devices whose roles they are.  See disk_get(). */
+static struct disk *roles[CHANNEL_CNT][2];
+
+/* Largest bounce buffer used for a transfer to or from user
+   memory, in pages.  When no pages are free, transfers use
+   BOUNCE_PAGE instead, one at a time. */
+#define BOUNCE_PAGES 8
+static uint8_t bounce_page[PGSIZE];
+static struct lock bounce_lock;
+
+static void ide_submit (struct disk_request *);
+
+/* Operations for ATA devices. */
+static const struct disk_operations ide_operations = {ide_submit};
+
 static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
 
-static void select_sector (struct disk *, disk_sector_t);
+static void channel_thread (void *);
+static void execute_request (struct disk_request *);
+static void complete_request (struct disk_request *);
+static void transfer (struct disk_request *, size_t ofs, size_t sec_cnt);
+static void submit_and_wait (struct disk *, disk_sector_t, size_t,
+                             void *, bool write);
+static void transfer_and_wait (struct disk *, disk_sector_t, size_t,
+                               void *, bool write);
+
+static bool select_sector (struct disk *, disk_sector_t, size_t sec_cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -104,6 +165,7 @@ disk_init (void)
 {
   size_t chan_no;
 
+  lock_init (&bounce_lock);
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
     {
       struct channel *c = &channels[chan_no];
@@ -125,6 +187,8 @@ disk_init (void)
           NOT_REACHED ();
         }
       lock_init (&c->lock);
+      cond_init (&c->queue_not_empty);
+      iosched_init (&c->queue);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
  
@@ -133,6 +197,8 @@ disk_init (void)
         {
           struct disk *d = &c->devices[dev_no];
           snprintf (d->name, sizeof d->name, "%s:%d", c->name, dev_no);
+          d->ops = &ide_operations;
+          d->aux = NULL;
           d->channel = c;
           d->dev_no = dev_no;
 
@@ -156,6 +222,15 @@ disk_init (void)
       for (dev_no = 0; dev_no < 2; dev_no++)
         if (c->devices[dev_no].is_ata)
           identify_ata_device (&c->devices[dev_no]);
+
+      /* Each ATA disk found fills its own role. */
+      for (dev_no = 0; dev_no < 2; dev_no++)
+        if (c->devices[dev_no].is_ata)
+          roles[chan_no][dev_no] = &c->devices[dev_no];
+
+      /* Start the driver thread, which now owns the controller. */
+      if (thread_create (c->name, PRI_MAX, channel_thread, c) == TID_ERROR)
+        PANIC ("%s: can't create driver thread", c->name);
     }
 }
 
@@ -163,7 +238,7 @@ disk_init (void)
 void
 disk_print_stats (void) 
 {
-  int chan_no;
+  size_t chan_no, i;
 
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++) 
     {
@@ -171,12 +246,19 @@ disk_print_stats (void)
 
       for (dev_no = 0; dev_no < 2; dev_no++) 
         {
-          struct disk *d = disk_get (chan_no, dev_no);
-          if (d != NULL && d->is_ata) 
+          struct disk *d = &channels[chan_no].devices[dev_no];
+          if (d->is_ata) 
             printf ("%s: %lld reads, %lld writes\n",
                     d->name, d->read_cnt, d->write_cnt);
         }
     }
+  for (i = 0; i < other_disk_cnt; i++) 
+    {
+      struct disk *d = &other_disks[i];
+      printf ("%s: %lld reads, %lld writes\n",
+              d->name, d->read_cnt, d->write_cnt);
+    }
+  iosched_print_stats ();
 }
 
 /* Returns the disk numbered DEV_NO--either 0 or 1 for master or
@@ -187,18 +269,17 @@ disk_print_stats (void)
         0:1 - file system
         1:0 - scratch
         1:1 - swap
-*/
+
+   Each role is normally filled by the ATA disk at that position,
+   but a disk provided by another driver may take over a role
+   with disk_set_role(). */
 struct disk *
 disk_get (int chan_no, int dev_no) 
 {
   ASSERT (dev_no == 0 || dev_no == 1);
 
   if (chan_no < (int) CHANNEL_CNT) 
-    {
-      struct disk *d = &channels[chan_no].devices[dev_no];
-      if (d->is_ata)
-        return d; 
-    }
+    return roles[chan_no][dev_no];
   return NULL;
 }
 
@@ -219,21 +300,7 @@ disk_size (struct disk *d)
 void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) 
 {
-  struct channel *c;
-  
-  ASSERT (d != NULL);
-  ASSERT (buffer != NULL);
-
-  c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
-  d->read_cnt++;
-  lock_release (&c->lock);
+  submit_and_wait (d, sec_no, 1, buffer, false);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -244,23 +311,345 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer)
 void
 disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer)
 {
-  struct channel *c;
-  
+  submit_and_wait (d, sec_no, 1, (void *) buffer, true);
+}
+
+/* Reads SEC_CNT consecutive sectors starting at SEC_NO from disk
+   D into BUFFER, which must have room for SEC_CNT *
+   DISK_SECTOR_SIZE bytes, as a single request.  Returns after
+   all the sectors have been read. */
+void
+disk_read_sectors (struct disk *d, disk_sector_t sec_no, size_t sec_cnt,
+                   void *buffer) 
+{
+  submit_and_wait (d, sec_no, sec_cnt, buffer, false);
+}
+
+/* Writes SEC_CNT consecutive sectors starting at SEC_NO on disk
+   D from BUFFER, as a single request.  Returns after the disk
+   has acknowledged receiving all the data. */
+void
+disk_write_sectors (struct disk *d, disk_sector_t sec_no, size_t sec_cnt,
+                    const void *buffer) 
+{
+  submit_and_wait (d, sec_no, sec_cnt, (void *) buffer, true);
+}
+
+/* Hands request R to its disk's driver and returns without
+   waiting for it to be carried out.  R's disk, sector,
+   sector_cnt, buffer, and write members must be set; callback,
+   aux, and done may be null.  When the transfer finishes, R's
+   callback is invoked (if non-null) and then R's done semaphore
+   is up'd (if non-null).  R and its buffer must not be touched
+   by the caller until then. */
+void
+disk_submit (struct disk_request *r) 
+{
+  ASSERT (r != NULL);
+  ASSERT (r->disk != NULL);
+  ASSERT (r->buffer != NULL);
+  ASSERT (r->sector_cnt > 0);
+  ASSERT (r->sector <= r->disk->capacity);
+  ASSERT (r->sector_cnt <= r->disk->capacity - r->sector);
+
+  r->disk->ops->submit (r);
+}
+
+/* Transfers SEC_CNT sectors starting at SEC_NO between disk D
+   and BUFFER, writing if WRITE is true and reading otherwise,
+   and waits for the transfer to complete.
+
+   Drivers carry out requests in their own threads, which run
+   without any process's page directory and so cannot touch user
+   memory.  A transfer to or from a user buffer therefore goes
+   through a kernel bounce buffer, copied here, in the caller's
+   context, where the user buffer is mapped. */
+static void
+submit_and_wait (struct disk *d, disk_sector_t sec_no, size_t sec_cnt,
+                 void *buffer, bool write) 
+{
+  uint8_t *bounce;
+  size_t bounce_pages, chunk_sectors;
+
   ASSERT (d != NULL);
   ASSERT (buffer != NULL);
 
-  c = d->channel;
+  if (!is_user_vaddr (buffer))
+    {
+      transfer_and_wait (d, sec_no, sec_cnt, buffer, write);
+      return;
+    }
+
+  /* Take as large a bounce buffer as is needed and available, or
+     fall back to the static bounce page. */
+  bounce_pages = DIV_ROUND_UP (sec_cnt * DISK_SECTOR_SIZE, PGSIZE);
+  if (bounce_pages > BOUNCE_PAGES)
+    bounce_pages = BOUNCE_PAGES;
+  for (bounce = NULL; bounce_pages > 0; bounce_pages /= 2)
+    {
+      bounce = palloc_get_multiple (0, bounce_pages);
+      if (bounce != NULL)
+        break;
+    }
+  if (bounce == NULL)
+    {
+      lock_acquire (&bounce_lock);
+      bounce = bounce_page;
+      bounce_pages = 1;
+    }
+  chunk_sectors = bounce_pages * PGSIZE / DISK_SECTOR_SIZE;
+
+  while (sec_cnt > 0)
+    {
+      size_t cnt = sec_cnt < chunk_sectors ? sec_cnt : chunk_sectors;
+      size_t size = cnt * DISK_SECTOR_SIZE;
+
+      if (write)
+        memcpy (bounce, buffer, size);
+      transfer_and_wait (d, sec_no, cnt, bounce, write);
+      if (!write)
+        memcpy (buffer, bounce, size);
+
+      sec_no += cnt;
+      sec_cnt -= cnt;
+      buffer = (uint8_t *) buffer + size;
+    }
+
+  if (bounce == bounce_page)
+    lock_release (&bounce_lock);
+  else
+    palloc_free_multiple (bounce, bounce_pages);
+}
+
+/* Transfers SEC_CNT sectors starting at SEC_NO between disk D
+   and kernel BUFFER, writing if WRITE is true and reading
+   otherwise, and waits for the transfer to complete. */
+static void
+transfer_and_wait (struct disk *d, disk_sector_t sec_no, size_t sec_cnt,
+                   void *buffer, bool write) 
+{
+  struct disk_request r;
+  struct semaphore done;
+
+  sema_init (&done, 0);
+  r.disk = d;
+  r.sector = sec_no;
+  r.sector_cnt = sec_cnt;
+  r.buffer = buffer;
+  r.write = write;
+  r.callback = NULL;
+  r.aux = NULL;
+  r.done = &done;
+  disk_submit (&r);
+  sema_down (&done);
+}
+
+/* Creates and returns a new disk named NAME with CAPACITY
+   sectors, whose requests are carried out by OPS.  AUX is
+   available to the driver through disk_aux().  The new disk
+   fills no role until one is given to it with disk_set_role().
+   Returns a null pointer if too many disks have been
+   registered. */
+struct disk *
+disk_register (const char *name, disk_sector_t capacity,
+               const struct disk_operations *ops, void *aux) 
+{
+  struct disk *d;
+
+  ASSERT (ops != NULL && ops->submit != NULL);
+
+  if (other_disk_cnt >= OTHER_DISK_CNT) 
+    {
+      printf ("%s: too many disks, ignoring\n", name);
+      return NULL;
+    }
+
+  d = &other_disks[other_disk_cnt++];
+  strlcpy (d->name, name, sizeof d->name);
+  d->ops = ops;
+  d->aux = aux;
+  d->capacity = capacity;
+  d->channel = NULL;
+  d->dev_no = 0;
+  d->is_ata = false;
+  d->read_cnt = d->write_cnt = 0;
+  return d;
+}
+
+/* Makes D the disk returned by disk_get(CHAN_NO, DEV_NO), in
+   place of any disk that filled that role before. */
+void
+disk_set_role (struct disk *d, int chan_no, int dev_no) 
+{
+  ASSERT (d != NULL);
+  ASSERT (chan_no >= 0 && chan_no < (int) CHANNEL_CNT);
+  ASSERT (dev_no == 0 || dev_no == 1);
+
+  roles[chan_no][dev_no] = d;
+  printf ("%s: serving as hd%d:%d\n", d->name, chan_no, dev_no);
+}
+
+/* Returns the AUX value that D was registered with. */
+void *
+disk_aux (struct disk *d) 
+{
+  ASSERT (d != NULL);
+  return d->aux;
+}
+
+/* Called by a disk's driver when request R has completed.
+   Updates statistics and signals R's submitter.  May be called
+   from an interrupt handler. */
+void
+disk_request_done (struct disk_request *r) 
+{
+  /* Fetch DONE first: the callback may free R. */
+  struct semaphore *done = r->done;
+
+  if (r->write)
+    r->disk->write_cnt += r->sector_cnt;
+  else
+    r->disk->read_cnt += r->sector_cnt;
+  if (r->callback != NULL)
+    r->callback (r);
+  if (done != NULL)
+    sema_up (done);
+}
+
+/* Request dispatching for ATA devices. */
+
+/* Queues request R on its disk's channel. */
+static void
+ide_submit (struct disk_request *r) 
+{
+  struct channel *c = r->disk->channel;
+
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
-  d->write_cnt++;
+  iosched_add (&c->queue, r);
+  cond_signal (&c->queue_not_empty, &c->lock);
   lock_release (&c->lock);
 }
-
+
+/* Driver thread for channel C_.  Takes requests off the
+   channel's queue one at a time and executes them, so the
+   controller never idles while work is pending. */
+static void
+channel_thread (void *c_) 
+{
+  struct channel *c = c_;
+
+  for (;;) 
+    {
+      struct disk_request *r;
+
+      lock_acquire (&c->lock);
+      while (iosched_empty (&c->queue))
+        cond_wait (&c->queue_not_empty, &c->lock);
+      r = iosched_next (&c->queue);
+      lock_release (&c->lock);
+
+      execute_request (r);
+      complete_request (r);
+    }
+}
+
+/* Carries out request R, together with any requests merged into
+   it, splitting it into as many commands as needed. */
+static void
+execute_request (struct disk_request *r) 
+{
+  size_t ofs;
+
+  ASSERT (list_empty (&r->merged) || r->group_cnt <= MAX_XFER_SECTORS);
+
+  for (ofs = 0; ofs < r->group_cnt; ofs += MAX_XFER_SECTORS) 
+    {
+      size_t left = r->group_cnt - ofs;
+      transfer (r, ofs, left < MAX_XFER_SECTORS ? left : MAX_XFER_SECTORS);
+    }
+}
+
+/* Signals the submitters of R and of the requests merged into it
+   that they have completed. */
+static void
+complete_request (struct disk_request *r) 
+{
+  while (!list_empty (&r->merged)) 
+    {
+      struct list_elem *e = list_pop_front (&r->merged);
+      complete_request (list_entry (e, struct disk_request, elem));
+    }
+
+  iosched_complete (r);
+  disk_request_done (r);
+}
+
+/* Returns a pointer to the data for sector OFS of the group of
+   requests headed by R, updating *CUR and *E to track the
+   request that contains it.  *CUR must initially be R and *E
+   the beginning of R's MERGED list, and OFS must increase by one
+   from one call to the next. */
+static uint8_t *
+group_buffer (struct disk_request *r, struct disk_request **cur,
+              struct list_elem **e, size_t *cur_ofs) 
+{
+  if (*cur_ofs == (*cur)->sector_cnt) 
+    {
+      ASSERT (*e != list_end (&r->merged));
+      *cur = list_entry (*e, struct disk_request, elem);
+      *e = list_next (*e);
+      *cur_ofs = 0;
+    }
+  return (uint8_t *) (*cur)->buffer + (*cur_ofs)++ * DISK_SECTOR_SIZE;
+}
+
+/* Issues a single PIO command that transfers SEC_CNT sectors, at
+   most MAX_XFER_SECTORS, starting OFS sectors into the group of
+   requests headed by R.  If R has merged requests then OFS must
+   be 0.  Must only be called from the disk's driver thread. */
+static void
+transfer (struct disk_request *r, size_t ofs, size_t sec_cnt) 
+{
+  struct disk *d = r->disk;
+  struct channel *c = d->channel;
+  disk_sector_t sec_no = r->sector + ofs;
+  struct disk_request *cur = r;
+  struct list_elem *e = list_begin (&r->merged);
+  size_t cur_ofs = ofs;
+  size_t i;
+  bool ext;
+
+  ASSERT (sec_cnt > 0 && sec_cnt <= MAX_XFER_SECTORS);
+  ASSERT (ofs == 0 || list_empty (&r->merged));
+
+  ext = select_sector (d, sec_no, sec_cnt);
+  if (!r->write) 
+    {
+      issue_pio_command (c, ext ? CMD_READ_SECTOR_EXT : CMD_READ_SECTOR_RETRY);
+      for (i = 0; i < sec_cnt; i++) 
+        {
+          sema_down (&c->completion_wait);
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk read failed, sector=%"PRDSNu,
+                   d->name, sec_no + i);
+          input_sector (c, group_buffer (r, &cur, &e, &cur_ofs));
+        }
+    }
+  else
+    {
+      issue_pio_command (c, (ext ? CMD_WRITE_SECTOR_EXT
+                             : CMD_WRITE_SECTOR_RETRY));
+      for (i = 0; i < sec_cnt; i++) 
+        {
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk write failed, sector=%"PRDSNu,
+                   d->name, sec_no + i);
+          output_sector (c, group_buffer (r, &cur, &e, &cur_ofs));
+          sema_down (&c->completion_wait);
+        }
+    }
+}
+
 /* Disk detection and identification. */
 
 static void print_ata_string (char *string, size_t size);
@@ -383,8 +772,18 @@ identify_ata_device (struct disk *d)
     }
   input_sector (c, id);
 
-  /* Calculate capacity. */
+  /* Calculate capacity.  Disks that support LBA48 (word 83, bit
+     10) report their full size in words 100 through 103; we can
+     only address the first 2**32 sectors of it. */
   d->capacity = id[60] | ((uint32_t) id[61] << 16);
+  d->lba48 = (id[83] & (1 << 10)) != 0;
+  if (d->lba48)
+    {
+      if (id[102] != 0 || id[103] != 0)
+        d->capacity = UINT32_MAX;
+      else
+        d->capacity = id[100] | ((uint32_t) id[101] << 16);
+    }
 
   /* Print identification message. */
   printf ("%s: detected %'"PRDSNu" sector (", d->name, d->capacity);
@@ -426,23 +825,47 @@ print_ata_string (char *string, size_t size)
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
-static void
-select_sector (struct disk *d, disk_sector_t sec_no) 
+   writes SEC_NO and SEC_CNT to the disk's sector selection
+   registers.  (We use LBA mode.)  Returns true if the transfer
+   reaches past the first LBA28_SECTORS sectors, in which case the
+   registers are loaded for LBA48 and the caller must issue an
+   LBA48 command. */
+static bool
+select_sector (struct disk *d, disk_sector_t sec_no, size_t sec_cnt) 
 {
   struct channel *c = d->channel;
+  uint8_t dev = DEV_MBS | DEV_LBA | (d->dev_no == 1 ? DEV_DEV : 0);
 
   ASSERT (sec_no < d->capacity);
-  ASSERT (sec_no < (1UL << 28));
+  ASSERT (sec_cnt > 0 && sec_cnt <= MAX_XFER_SECTORS);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
-  outb (reg_lbal (c), sec_no);
-  outb (reg_lbam (c), sec_no >> 8);
-  outb (reg_lbah (c), (sec_no >> 16));
-  outb (reg_device (c),
-        DEV_MBS | DEV_LBA | (d->dev_no == 1 ? DEV_DEV : 0) | (sec_no >> 24));
+  if (sec_no + sec_cnt <= LBA28_SECTORS) 
+    {
+      outb (reg_nsect (c), sec_cnt % MAX_XFER_SECTORS);
+      outb (reg_lbal (c), sec_no);
+      outb (reg_lbam (c), sec_no >> 8);
+      outb (reg_lbah (c), (sec_no >> 16));
+      outb (reg_device (c), dev | (sec_no >> 24));
+      return false;
+    }
+  else
+    {
+      /* Each register is a two-byte FIFO: write the high-order
+         byte first, then the low-order byte.  Our sector numbers
+         have only 32 bits, so LBA bits 32 through 47 are 0. */
+      ASSERT (d->lba48);
+      outb (reg_nsect (c), sec_cnt >> 8);
+      outb (reg_lbal (c), sec_no >> 24);
+      outb (reg_lbam (c), 0);
+      outb (reg_lbah (c), 0);
+      outb (reg_nsect (c), sec_cnt);
+      outb (reg_lbal (c), sec_no);
+      outb (reg_lbam (c), sec_no >> 8);
+      outb (reg_lbah (c), sec_no >> 16);
+      outb (reg_device (c), dev);
+      return true;
+    }
 }
 
 /* Writes COMMAND to channel C and prepares for receiving a
@@ -2,6 +2,9 @@
 #define DEVICES_DISK_H
 
 #include <inttypes.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /* Size of a disk sector in bytes. */
@@ -15,6 +18,39 @@ typedef uint32_t disk_sector_t;
    printf ("sector=%"PRDSNu"\n", sector); */
 #define PRDSNu PRIu32
 
+struct semaphore;
+struct disk_request;
+
+/* Called when a disk request completes.
+   Runs in the context of the disk driver, possibly in an
+   interrupt handler, so it must not sleep or wait for further
+   disk I/O. */
+typedef void disk_callback_func (struct disk_request *);
+
+/* A request to transfer SECTOR_CNT consecutive sectors between
+   a disk and memory.  The submitter owns the request and its
+   buffer until completion is signaled through CALLBACK (if
+   non-null) and then DONE (if non-null). */
+struct disk_request
+  {
+    struct list_elem elem;              /* Element in device queue. */
+    struct disk *disk;                  /* Disk to access. */
+    disk_sector_t sector;               /* First sector to transfer. */
+    size_t sector_cnt;                  /* Number of sectors. */
+    void *buffer;                       /* SECTOR_CNT sectors of data. */
+    bool write;                         /* True to write, false to read. */
+    disk_callback_func *callback;       /* Completion callback or null. */
+    void *aux;                          /* For use by CALLBACK. */
+    struct semaphore *done;             /* Up'd on completion or null. */
+
+    /* Owned by the I/O scheduler (devices/iosched.c). */
+    int priority;                       /* Submitting thread's priority. */
+    int64_t submit_time;                /* Timer tick of submission. */
+    int64_t deadline;                   /* Tick by which to dispatch. */
+    size_t group_cnt;                   /* Sectors including MERGED. */
+    struct list merged;                 /* Adjacent requests merged in. */
+  };
+
 void disk_init (void);
 void disk_print_stats (void);
 
@@ -22,5 +58,27 @@ struct disk *disk_get (int chan_no, int dev_no);
 disk_sector_t disk_size (struct disk *);
 void disk_read (struct disk *, disk_sector_t, void *);
 void disk_write (struct disk *, disk_sector_t, const void *);
+void disk_read_sectors (struct disk *, disk_sector_t, size_t, void *);
+void disk_write_sectors (struct disk *, disk_sector_t, size_t,
+                         const void *);
+void disk_submit (struct disk_request *);
+
+/* Interface for disk drivers other than the built-in IDE
+   driver. */
+
+/* Operations provided by a disk driver. */
+struct disk_operations
+  {
+    /* Starts carrying out request R, whose disk belongs to the
+       driver, and arranges for disk_request_done() to be called
+       when it completes.  Called in thread context. */
+    void (*submit) (struct disk_request *r);
+  };
+
+struct disk *disk_register (const char *name, disk_sector_t capacity,
+                            const struct disk_operations *, void *aux);
+void disk_set_role (struct disk *, int chan_no, int dev_no);
+void *disk_aux (struct disk *);
+void disk_request_done (struct disk_request *);
 
 #endif /* devices/disk.h */
@@ -0,0 +1,416 @@
+#include "devices/iosched.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+
+/* Three policies are provided:
+
+   - "fifo" dispatches requests in the order they were
+     submitted.
+
+   - "clook" sweeps the disk in ascending sector order and jumps
+     back to the lowest pending sector when nothing is left
+     ahead of the head (C-LOOK).  A request submitted for
+     sectors just after, or just before, a queued request of the
+     same kind is merged into it, so interleaved sequential
+     streams turn into long transfers.
+
+   - "deadline" works like "clook" but also gives every request
+     an expiry time, shorter for reads than for writes.  Once
+     the earliest expiry passes, that request is dispatched
+     ahead of the sweep, which bounds read latency.
+
+   In every policy but "fifo", requests are weighted by the
+   priority of the thread that submitted them: only requests
+   within PRI_BAND levels of the most important pending request
+   are eligible for dispatch, and in "deadline" higher priority
+   also means an earlier expiry. */
+
+/* Number of buckets in each histogram.  Bucket 0 counts the
+   value 0, and bucket I > 0 counts values from 2**(I-1) up to
+   but not including 2**I.  The last bucket also counts all
+   larger values. */
+#define HIST_BUCKETS 12
+
+/* Requests submitted by threads within this many priority
+   levels of the highest-priority pending request compete on
+   equal terms. */
+#define PRI_BAND 4
+
+/* Deadline policy: timer ticks that a request submitted by a
+   PRI_DEFAULT thread may wait before it is dispatched ahead of
+   the sweep. */
+#define READ_EXPIRE (TIMER_FREQ / 10)   /* 100 ms. */
+#define WRITE_EXPIRE (TIMER_FREQ)       /* 1 s. */
+
+/* Maximum size of a group of merged requests, in sectors.  This
+   is the most that one ATA command can transfer. */
+#define MAX_GROUP_SECTORS 256
+
+/* Statistics for one policy. */
+struct policy_stats
+  {
+    long long dispatch_cnt;             /* Groups dispatched. */
+    long long merge_cnt;                /* Requests merged into others. */
+    long long depth[HIST_BUCKETS];      /* Queue depth after each add. */
+    long long latency[HIST_BUCKETS];    /* Ticks from submit to finish. */
+  };
+
+/* A scheduling policy. */
+struct policy
+  {
+    const char *name;                   /* Name for "-iosched=". */
+    bool merge;                         /* Merge adjacent requests? */
+    struct disk_request *(*pick) (struct iosched_queue *);
+    struct policy_stats stats;          /* Statistics. */
+  };
+
+static struct disk_request *pick_fifo (struct iosched_queue *);
+static struct disk_request *pick_clook (struct iosched_queue *);
+static struct disk_request *pick_deadline (struct iosched_queue *);
+
+/* Available policies. */
+static struct policy policies[] =
+  {
+    {"fifo", false, pick_fifo, {0, 0, {0}, {0}}},
+    {"clook", true, pick_clook, {0, 0, {0}, {0}}},
+    {"deadline", true, pick_deadline, {0, 0, {0}, {0}}},
+  };
+#define POLICY_CNT (sizeof policies / sizeof *policies)
+
+/* Active policy. */
+static struct policy *policy = &policies[2];
+
+static bool try_merge (struct iosched_queue *, struct disk_request *);
+static bool conflicts (const struct disk_request *,
+                       const struct disk_request *);
+static bool is_blocked (struct iosched_queue *, struct disk_request *);
+static void count (long long *);
+static void record (long long hist[HIST_BUCKETS], int64_t value);
+
+/* Makes the policy named NAME the active policy.  Returns true
+   if successful, false if there is no such policy.  Must be
+   called before any queue is initialized. */
+bool
+iosched_select (const char *name)
+{
+  size_t i;
+
+  for (i = 0; i < POLICY_CNT; i++)
+    if (!strcmp (name, policies[i].name))
+      {
+        policy = &policies[i];
+        return true;
+      }
+  return false;
+}
+
+/* Initializes Q as an empty queue. */
+void
+iosched_init (struct iosched_queue *q)
+{
+  list_init (&q->requests);
+  q->depth = 0;
+  q->head_disk = NULL;
+  q->head_sector = 0;
+}
+
+/* Returns true if Q has no pending requests. */
+bool
+iosched_empty (struct iosched_queue *q)
+{
+  return list_empty (&q->requests);
+}
+
+/* Adds R, which was just submitted by the running thread, to
+   Q. */
+void
+iosched_add (struct iosched_queue *q, struct disk_request *r)
+{
+  int64_t expire = r->write ? WRITE_EXPIRE : READ_EXPIRE;
+
+  /* Weight the expiry by priority: PRI_DEFAULT gets the base
+     value, PRI_MAX expires almost at once, and PRI_MIN waits
+     about twice as long as PRI_DEFAULT. */
+  r->priority = thread_get_priority ();
+  r->submit_time = timer_ticks ();
+  r->deadline = (r->submit_time
+                 + expire * (PRI_MAX + 1 - r->priority)
+                 / (PRI_MAX + 1 - PRI_DEFAULT));
+  r->group_cnt = r->sector_cnt;
+  list_init (&r->merged);
+
+  if (policy->merge && try_merge (q, r))
+    count (&policy->stats.merge_cnt);
+  else
+    {
+      list_push_back (&q->requests, &r->elem);
+      q->depth++;
+    }
+  record (policy->stats.depth, q->depth);
+}
+
+/* Removes and returns the request in Q that should be carried
+   out next.  Q must not be empty.
+
+   The returned request carries the requests merged into it on
+   its MERGED list.  Together they cover GROUP_CNT consecutive
+   sectors starting at its SECTOR, in ascending order, and should
+   be transferred by a single command. */
+struct disk_request *
+iosched_next (struct iosched_queue *q)
+{
+  struct disk_request *r;
+
+  ASSERT (!iosched_empty (q));
+
+  r = policy->pick (q);
+  list_remove (&r->elem);
+  q->depth--;
+  q->head_disk = r->disk;
+  q->head_sector = r->sector + r->group_cnt;
+  count (&policy->stats.dispatch_cnt);
+  return r;
+}
+
+/* Records the completion of R for statistical purposes.  Must
+   be called for every request, including those that were merged
+   into others. */
+void
+iosched_complete (struct disk_request *r)
+{
+  record (policy->stats.latency, timer_elapsed (r->submit_time));
+}
+
+/* Prints statistics for the active policy. */
+void
+iosched_print_stats (void)
+{
+  const struct policy_stats *s = &policy->stats;
+  int i;
+
+  printf ("I/O scheduler: %s policy, %lld dispatches, %lld merges\n",
+          policy->name, s->dispatch_cnt, s->merge_cnt);
+  printf ("  queue depth:");
+  for (i = 0; i < HIST_BUCKETS; i++)
+    if (s->depth[i] != 0)
+      printf (" %d+:%lld", i == 0 ? 0 : 1 << (i - 1), s->depth[i]);
+  printf ("\n  latency (ticks):");
+  for (i = 0; i < HIST_BUCKETS; i++)
+    if (s->latency[i] != 0)
+      printf (" %d+:%lld", i == 0 ? 0 : 1 << (i - 1), s->latency[i]);
+  printf ("\n");
+}
+
+/* Merging. */
+
+/* Returns true if requests A and B may be merged into a single
+   transfer, given that they are adjacent on disk. */
+static bool
+can_merge (const struct disk_request *a, const struct disk_request *b)
+{
+  return (a->disk == b->disk
+          && a->write == b->write
+          && a->group_cnt + b->group_cnt <= MAX_GROUP_SECTORS);
+}
+
+/* Tries to merge newly added request R into a request already in
+   Q that is adjacent to it on disk.  Returns true if successful,
+   false if R must be queued on its own. */
+static bool
+try_merge (struct iosched_queue *q, struct disk_request *r)
+{
+  struct list_elem *e;
+
+  /* Merging moves R ahead of requests queued before it, which
+     is only safe if none of them conflicts with it. */
+  for (e = list_begin (&q->requests); e != list_end (&q->requests);
+       e = list_next (e))
+    if (conflicts (list_entry (e, struct disk_request, elem), r))
+      return false;
+
+  for (e = list_begin (&q->requests); e != list_end (&q->requests);
+       e = list_next (e))
+    {
+      struct disk_request *p = list_entry (e, struct disk_request, elem);
+      if (!can_merge (p, r))
+        continue;
+
+      if (p->sector + p->group_cnt == r->sector)
+        {
+          /* R follows P: append it to P's group. */
+          list_push_back (&p->merged, &r->elem);
+          p->group_cnt += r->sector_cnt;
+        }
+      else if (r->sector + r->sector_cnt == p->sector)
+        {
+          /* R precedes P: R takes P's place in the queue and
+             heads the group. */
+          list_insert (e, &r->elem);
+          list_remove (e);
+          list_push_back (&r->merged, &p->elem);
+          list_splice (list_end (&r->merged),
+                       list_begin (&p->merged), list_end (&p->merged));
+          r->group_cnt += p->group_cnt;
+          p->group_cnt = p->sector_cnt;
+          p = r;
+        }
+      else
+        continue;
+
+      /* The group is as urgent as its most urgent member. */
+      if (r->priority > p->priority)
+        p->priority = r->priority;
+      if (r->deadline < p->deadline)
+        p->deadline = r->deadline;
+      return true;
+    }
+  return false;
+}
+
+/* Ordering. */
+
+/* Returns true if requests A and B overlap and at least one of
+   them is a write.  Such requests must be carried out in
+   submission order. */
+static bool
+conflicts (const struct disk_request *a, const struct disk_request *b)
+{
+  return (a->disk == b->disk
+          && (a->write || b->write)
+          && a->sector < b->sector + b->group_cnt
+          && b->sector < a->sector + a->group_cnt);
+}
+
+/* Returns true if R conflicts with a request that was queued
+   before it. */
+static bool
+is_blocked (struct iosched_queue *q, struct disk_request *r)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&q->requests); e != &r->elem; e = list_next (e))
+    if (conflicts (list_entry (e, struct disk_request, elem), r))
+      return true;
+  return false;
+}
+
+/* Policies. */
+
+/* Returns true if A lies before B in the order that the C-LOOK
+   sweep visits requests: by disk, then by sector. */
+static bool
+position_less (const struct disk *a_disk, disk_sector_t a_sector,
+               const struct disk *b_disk, disk_sector_t b_sector)
+{
+  if (a_disk != b_disk)
+    return (uintptr_t) a_disk < (uintptr_t) b_disk;
+  else
+    return a_sector < b_sector;
+}
+
+/* "fifo" policy: the oldest request. */
+static struct disk_request *
+pick_fifo (struct iosched_queue *q)
+{
+  return list_entry (list_front (&q->requests), struct disk_request, elem);
+}
+
+/* "clook" policy: among sufficiently important requests, the
+   nearest one at or after the head, or the lowest one if none
+   is ahead. */
+static struct disk_request *
+pick_clook (struct iosched_queue *q)
+{
+  struct disk_request *ahead = NULL, *lowest = NULL;
+  struct list_elem *e;
+  int top = PRI_MIN;
+
+  for (e = list_begin (&q->requests); e != list_end (&q->requests);
+       e = list_next (e))
+    {
+      struct disk_request *r = list_entry (e, struct disk_request, elem);
+      if (r->priority > top)
+        top = r->priority;
+    }
+
+  for (e = list_begin (&q->requests); e != list_end (&q->requests);
+       e = list_next (e))
+    {
+      struct disk_request *r = list_entry (e, struct disk_request, elem);
+      if (r->priority < top - PRI_BAND || is_blocked (q, r))
+        continue;
+
+      if (!position_less (r->disk, r->sector, q->head_disk, q->head_sector)
+          && (ahead == NULL
+              || position_less (r->disk, r->sector,
+                                ahead->disk, ahead->sector)))
+        ahead = r;
+      if (lowest == NULL
+          || position_less (r->disk, r->sector, lowest->disk, lowest->sector))
+        lowest = r;
+    }
+
+  if (ahead != NULL)
+    return ahead;
+  else if (lowest != NULL)
+    return lowest;
+  else
+    {
+      /* Every important request waits for an older, less
+         important one. */
+      return pick_fifo (q);
+    }
+}
+
+/* "deadline" policy: the request with the earliest expiry, if
+   it has expired, otherwise the same as "clook". */
+static struct disk_request *
+pick_deadline (struct iosched_queue *q)
+{
+  struct disk_request *earliest = NULL;
+  struct list_elem *e;
+
+  for (e = list_begin (&q->requests); e != list_end (&q->requests);
+       e = list_next (e))
+    {
+      struct disk_request *r = list_entry (e, struct disk_request, elem);
+      if ((earliest == NULL || r->deadline < earliest->deadline)
+          && !is_blocked (q, r))
+        earliest = r;
+    }
+
+  if (earliest != NULL && earliest->deadline <= timer_ticks ())
+    return earliest;
+  else
+    return pick_clook (q);
+}
+
+/* Statistics. */
+
+/* Increments *CNT.  Both channels' driver threads update the
+   same counters, so this is done with interrupts off. */
+static void
+count (long long *cnt)
+{
+  enum intr_level old_level = intr_disable ();
+  (*cnt)++;
+  intr_set_level (old_level);
+}
+
+/* Adds VALUE to histogram HIST. */
+static void
+record (long long hist[HIST_BUCKETS], int64_t value)
+{
+  int bucket = 0;
+
+  while (value > 0 && bucket < HIST_BUCKETS - 1)
+    {
+      value >>= 1;
+      bucket++;
+    }
+  count (&hist[bucket]);
+}
@@ -0,0 +1,39 @@
+#ifndef DEVICES_IOSCHED_H
+#define DEVICES_IOSCHED_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "devices/disk.h"
+
+/* Disk I/O scheduler.
+
+   Each disk channel keeps its pending requests in an
+   iosched_queue.  The active scheduling policy, chosen with the
+   kernel command-line option "-iosched=NAME", decides which
+   pending request the channel's driver thread carries out next
+   and whether newly submitted requests may be merged into
+   requests that are already queued.
+
+   Queue functions do no locking of their own; callers must
+   serialize access to each queue. */
+
+/* A queue of pending disk requests. */
+struct iosched_queue
+  {
+    struct list requests;       /* Pending requests, oldest first. */
+    size_t depth;               /* Number of requests in REQUESTS. */
+    const struct disk *head_disk;       /* Disk last dispatched to. */
+    disk_sector_t head_sector;  /* Sector following last dispatch. */
+  };
+
+bool iosched_select (const char *name);
+void iosched_init (struct iosched_queue *);
+bool iosched_empty (struct iosched_queue *);
+void iosched_add (struct iosched_queue *, struct disk_request *);
+struct disk_request *iosched_next (struct iosched_queue *);
+void iosched_complete (struct disk_request *);
+void iosched_print_stats (void);
+
+#endif /* devices/iosched.h */
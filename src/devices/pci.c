@@ -0,0 +1,159 @@
+#include "devices/pci.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/io.h"
+
+/* The code in this file enumerates the PCI bus using
+   configuration mechanism #1 [PCI-LB] 3.2.2.3.2, which every PC
+   chipset we care about implements.  It records every function
+   it finds so that device drivers can look themselves up by
+   vendor and device ID. */
+
+/* Configuration mechanism #1 ports. */
+#define CONFIG_ADDRESS 0xcf8    /* Selects a configuration register. */
+#define CONFIG_DATA 0xcfc       /* Accesses the selected register. */
+
+/* Standard configuration space header registers. */
+#define REG_ID 0x00             /* Vendor ID 15:0, device ID 31:16. */
+#define REG_CLASS 0x08          /* Class code 31:24, subclass 23:16. */
+#define REG_HEADER 0x0c         /* Header type in bits 23:16. */
+
+/* Header type register bits. */
+#define HEADER_MULTIFUNC 0x80   /* Device has multiple functions. */
+
+/* Maximum number of functions we keep track of. */
+#define MAX_DEVS 32
+static struct pci_dev devs[MAX_DEVS];
+static size_t dev_cnt;
+
+static void select_register (int bus, int slot, int func, int reg);
+static uint32_t read_config (int bus, int slot, int func, int reg);
+static void probe_function (int bus, int slot, int func);
+
+/* Enumerates the PCI bus and prints a line for each function
+   found. */
+void
+pci_init (void)
+{
+  int bus, slot, func;
+
+  for (bus = 0; bus < 256; bus++)
+    for (slot = 0; slot < 32; slot++)
+      {
+        if ((read_config (bus, slot, 0, REG_ID) & 0xffff) == 0xffff)
+          continue;
+
+        probe_function (bus, slot, 0);
+        if ((read_config (bus, slot, 0, REG_HEADER) >> 16)
+            & HEADER_MULTIFUNC)
+          for (func = 1; func < 8; func++)
+            if ((read_config (bus, slot, func, REG_ID) & 0xffff) != 0xffff)
+              probe_function (bus, slot, func);
+      }
+}
+
+/* Returns the IDX'th function (counting from 0) with the given
+   VENDOR_ID and DEVICE_ID, or a null pointer if there is no such
+   function. */
+struct pci_dev *
+pci_find (uint16_t vendor_id, uint16_t device_id, size_t idx)
+{
+  size_t i;
+
+  for (i = 0; i < dev_cnt; i++)
+    if (devs[i].vendor_id == vendor_id && devs[i].device_id == device_id
+        && idx-- == 0)
+      return &devs[i];
+  return NULL;
+}
+
+/* Reads and returns the 32-bit configuration register REG of
+   device D.  REG must be a multiple of 4. */
+uint32_t
+pci_read_config (const struct pci_dev *d, int reg)
+{
+  return read_config (d->bus, d->slot, d->func, reg);
+}
+
+/* Writes VALUE to 32-bit configuration register REG of device D.
+   REG must be a multiple of 4. */
+void
+pci_write_config (const struct pci_dev *d, int reg, uint32_t value)
+{
+  select_register (d->bus, d->slot, d->func, reg);
+  outl (CONFIG_DATA, value);
+}
+
+/* Returns the base address in base address register BAR (0...5)
+   of device D, and sets *IS_IO to true if it is an I/O port
+   address or false if it is a memory address. */
+uint32_t
+pci_get_bar (const struct pci_dev *d, int bar, bool *is_io)
+{
+  uint32_t value;
+
+  ASSERT (bar >= 0 && bar < 6);
+  value = pci_read_config (d, PCI_REG_BAR0 + bar * 4);
+  *is_io = (value & 1) != 0;
+  return *is_io ? value & ~0x3u : value & ~0xfu;
+}
+
+/* Sets CMD_BITS (a combination of PCI_CMD_* bits) in device D's
+   command register. */
+void
+pci_enable (const struct pci_dev *d, uint16_t cmd_bits)
+{
+  uint32_t value = pci_read_config (d, PCI_REG_COMMAND);
+  pci_write_config (d, PCI_REG_COMMAND, value | cmd_bits);
+}
+
+/* Selects 32-bit configuration register REG of function FUNC of
+   device SLOT on bus BUS for access through CONFIG_DATA. */
+static void
+select_register (int bus, int slot, int func, int reg)
+{
+  ASSERT (reg % 4 == 0 && reg < 256);
+  outl (CONFIG_ADDRESS, (0x80000000 | (bus << 16) | (slot << 11)
+                         | (func << 8) | reg));
+}
+
+/* Reads and returns 32-bit configuration register REG of
+   function FUNC of device SLOT on bus BUS. */
+static uint32_t
+read_config (int bus, int slot, int func, int reg)
+{
+  select_register (bus, slot, func, reg);
+  return inl (CONFIG_DATA);
+}
+
+/* Records function FUNC of device SLOT on bus BUS, which is
+   known to exist. */
+static void
+probe_function (int bus, int slot, int func)
+{
+  struct pci_dev *d;
+  uint32_t id, class;
+
+  if (dev_cnt >= MAX_DEVS)
+    {
+      printf ("pci: too many devices, ignoring %02x:%02x.%d\n",
+              bus, slot, func);
+      return;
+    }
+
+  d = &devs[dev_cnt++];
+  id = read_config (bus, slot, func, REG_ID);
+  class = read_config (bus, slot, func, REG_CLASS);
+  d->bus = bus;
+  d->slot = slot;
+  d->func = func;
+  d->vendor_id = id & 0xffff;
+  d->device_id = id >> 16;
+  d->class = class >> 24;
+  d->subclass = class >> 16;
+  d->irq = read_config (bus, slot, func, PCI_REG_IRQ_LINE) & 0xff;
+
+  printf ("pci %02x:%02x.%d: %04x:%04x class %02x%02x irq %d\n",
+          d->bus, d->slot, d->func, d->vendor_id, d->device_id,
+          d->class, d->subclass, d->irq);
+}
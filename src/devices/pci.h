@@ -0,0 +1,40 @@
+#ifndef DEVICES_PCI_H
+#define DEVICES_PCI_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* A PCI function found during bus enumeration. */
+struct pci_dev
+  {
+    uint8_t bus;                /* Bus number. */
+    uint8_t slot;               /* Device number on bus. */
+    uint8_t func;               /* Function number within device. */
+    uint16_t vendor_id;         /* Vendor ID. */
+    uint16_t device_id;         /* Device ID. */
+    uint8_t class;              /* Base class code. */
+    uint8_t subclass;           /* Sub-class code. */
+    uint8_t irq;                /* Interrupt line (legacy PIC IRQ). */
+  };
+
+/* Indexes of interesting registers in configuration space. */
+#define PCI_REG_COMMAND 0x04    /* Command register (16 bits). */
+#define PCI_REG_BAR0 0x10       /* Base address register 0. */
+#define PCI_REG_IRQ_LINE 0x3c   /* Interrupt line (8 bits). */
+
+/* Command register bits. */
+#define PCI_CMD_IO 0x0001       /* I/O space enable. */
+#define PCI_CMD_MEMORY 0x0002   /* Memory space enable. */
+#define PCI_CMD_MASTER 0x0004   /* Bus master enable. */
+
+void pci_init (void);
+struct pci_dev *pci_find (uint16_t vendor_id, uint16_t device_id,
+                          size_t idx);
+
+uint32_t pci_read_config (const struct pci_dev *, int reg);
+void pci_write_config (const struct pci_dev *, int reg, uint32_t value);
+uint32_t pci_get_bar (const struct pci_dev *, int bar, bool *is_io);
+void pci_enable (const struct pci_dev *, uint16_t cmd_bits);
+
+#endif /* devices/pci.h */
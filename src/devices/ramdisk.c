@@ -0,0 +1,119 @@
+#include "devices/ramdisk.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/disk.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* A disk whose sectors live in kernel memory, selected with the
+   kernel command-line option "-ramdisk=KB".
+
+   The ramdisk replaces whatever disk would otherwise be the file
+   system disk (see disk_get()), so the file system and fsutil
+   run on it unchanged but without any device latency.  This
+   makes it useful for measuring the CPU cost of the file system
+   by itself.  Its contents are lost at power off, unless it is
+   preloaded from the scratch disk with "-ramdisk-load" and then
+   copied back out through the usual "pintos -g" path.
+
+   Memory comes from the kernel pool one page at a time, so it
+   need not be contiguous. */
+
+/* Sectors per page. */
+#define SECTORS_PER_PAGE (PGSIZE / DISK_SECTOR_SIZE)
+
+/* Pages holding the ramdisk's sectors, in order. */
+static uint8_t **pages;
+static size_t page_cnt;
+
+static void submit (struct disk_request *);
+static void preload_from (struct disk *src, struct disk *dst);
+
+/* Operations for the ramdisk. */
+static const struct disk_operations ramdisk_operations = {submit};
+
+/* Creates a ramdisk of SIZE_KB kB and makes it the file system
+   disk.  If PRELOAD is true, initializes it with the contents of
+   the scratch disk; otherwise, it starts out zeroed. */
+void
+ramdisk_init (size_t size_kb, bool preload)
+{
+  struct disk *d;
+  size_t i;
+
+  page_cnt = DIV_ROUND_UP (size_kb, PGSIZE / 1024);
+  if (page_cnt == 0)
+    return;
+  pages = malloc (page_cnt * sizeof *pages);
+  if (pages == NULL)
+    PANIC ("ramdisk: out of memory");
+  for (i = 0; i < page_cnt; i++)
+    {
+      pages[i] = palloc_get_page (PAL_ZERO);
+      if (pages[i] == NULL)
+        PANIC ("ramdisk: out of memory after %zu of %zu kB",
+               i * (PGSIZE / 1024), page_cnt * (PGSIZE / 1024));
+    }
+
+  d = disk_register ("rd0", page_cnt * SECTORS_PER_PAGE,
+                     &ramdisk_operations, NULL);
+  if (d == NULL)
+    PANIC ("ramdisk: could not register disk");
+  printf ("rd0: %zu kB ramdisk\n", page_cnt * (PGSIZE / 1024));
+
+  if (preload)
+    {
+      struct disk *scratch = disk_get (1, 0);
+      if (scratch == NULL)
+        PANIC ("ramdisk: no scratch disk to preload from");
+      preload_from (scratch, d);
+    }
+  disk_set_role (d, 0, 1);
+}
+
+/* Carries out request R by copying to or from memory. */
+static void
+submit (struct disk_request *r)
+{
+  uint8_t *buffer = r->buffer;
+  size_t i;
+
+  for (i = 0; i < r->sector_cnt; i++)
+    {
+      disk_sector_t sector = r->sector + i;
+      uint8_t *p = pages[sector / SECTORS_PER_PAGE]
+                   + sector % SECTORS_PER_PAGE * DISK_SECTOR_SIZE;
+
+      if (r->write)
+        memcpy (p, buffer, DISK_SECTOR_SIZE);
+      else
+        memcpy (buffer, p, DISK_SECTOR_SIZE);
+      buffer += DISK_SECTOR_SIZE;
+    }
+  disk_request_done (r);
+}
+
+/* Copies as many sectors as fit from SRC to DST, one page at a
+   time. */
+static void
+preload_from (struct disk *src, struct disk *dst)
+{
+  disk_sector_t cnt = disk_size (src);
+  disk_sector_t sector;
+
+  if (cnt > disk_size (dst))
+    cnt = disk_size (dst);
+  for (sector = 0; sector < cnt; sector += SECTORS_PER_PAGE)
+    {
+      size_t chunk = cnt - sector < SECTORS_PER_PAGE
+                     ? cnt - sector : SECTORS_PER_PAGE;
+
+      /* Read straight into the ramdisk's own page. */
+      disk_read_sectors (src, sector, chunk,
+                         pages[sector / SECTORS_PER_PAGE]);
+    }
+  printf ("rd0: preloaded %'"PRDSNu" sectors from scratch disk\n", cnt);
+}
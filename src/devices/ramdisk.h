@@ -0,0 +1,9 @@
+#ifndef DEVICES_RAMDISK_H
+#define DEVICES_RAMDISK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+void ramdisk_init (size_t size_kb, bool preload);
+
+#endif /* devices/ramdisk.h */
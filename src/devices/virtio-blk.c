@@ -0,0 +1,389 @@
+#include "devices/virtio-blk.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdio.h>
+#include "devices/disk.h"
+#include "devices/pci.h"
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Driver for "legacy" virtio block devices, as provided by QEMU
+   with "-drive if=virtio".  See "Virtio PCI Card Specification"
+   v0.9.5, sections 2.3 and 2.4 and appendix D.
+
+   Unlike the IDE driver, which moves every byte through I/O
+   ports with the CPU, a virtio disk transfers data directly to
+   or from memory and may have many requests outstanding at
+   once.  Requests are handed to the device as soon as they are
+   submitted; the device is free to reorder them, so we do not
+   run them through the I/O scheduler.
+
+   Each virtio disk found takes over the first of the file
+   system, scratch, and swap roles (see disk_get()) that no IDE
+   disk fills, in that order.  The "pintos" utility's "--virtio"
+   option attaches disks to match. */
+
+/* PCI IDs of a legacy virtio block device. */
+#define VIRTIO_VENDOR_ID 0x1af4
+#define VIRTIO_BLK_DEVICE_ID 0x1001
+
+/* Registers, as offsets from the base of the I/O port BAR. */
+#define REG_HOST_FEATURES 0x00  /* Features offered by device (32 bits). */
+#define REG_GUEST_FEATURES 0x04 /* Features accepted by driver (32 bits). */
+#define REG_QUEUE_PFN 0x08      /* Queue physical page number (32 bits). */
+#define REG_QUEUE_SIZE 0x0c     /* Queue size in descriptors (16 bits). */
+#define REG_QUEUE_SELECT 0x0e   /* Selects queue (16 bits). */
+#define REG_QUEUE_NOTIFY 0x10   /* Queue notification (16 bits). */
+#define REG_STATUS 0x12         /* Device status (8 bits). */
+#define REG_ISR 0x13            /* Interrupt status, read clears (8 bits). */
+#define REG_CAPACITY 0x14       /* Capacity in sectors (64 bits). */
+
+/* Device status bits. */
+#define STA_ACKNOWLEDGE 0x01    /* Guest has noticed the device. */
+#define STA_DRIVER 0x02         /* Guest knows how to drive it. */
+#define STA_DRIVER_OK 0x04      /* Driver is ready. */
+#define STA_FAILED 0x80         /* Driver gave up on the device. */
+
+/* Descriptor flags. */
+#define DESC_NEXT 0x1           /* NEXT field is valid. */
+#define DESC_WRITE 0x2          /* Device writes (vs. reads) buffer. */
+
+/* Block request types and status values. */
+#define BLK_T_IN 0              /* Read. */
+#define BLK_T_OUT 1             /* Write. */
+#define BLK_S_OK 0              /* Success. */
+
+/* Alignment of the used ring within a vring. */
+#define VRING_ALIGN 4096
+
+/* A buffer descriptor. */
+struct vring_desc
+  {
+    uint64_t addr;              /* Physical address. */
+    uint32_t len;               /* Length in bytes. */
+    uint16_t flags;             /* DESC_* flags. */
+    uint16_t next;              /* Next descriptor in chain. */
+  };
+
+/* Ring of descriptor chains offered to the device. */
+struct vring_avail
+  {
+    uint16_t flags;
+    uint16_t idx;               /* Where driver puts next entry. */
+    uint16_t ring[];            /* Heads of descriptor chains. */
+  };
+
+/* An entry in the used ring. */
+struct vring_used_elem
+  {
+    uint32_t id;                /* Head of completed chain. */
+    uint32_t len;               /* Bytes written by device. */
+  };
+
+/* Ring of descriptor chains returned by the device. */
+struct vring_used
+  {
+    uint16_t flags;
+    uint16_t idx;               /* Where device puts next entry. */
+    struct vring_used_elem ring[];
+  };
+
+/* Header at the start of each block request. */
+struct blk_header
+  {
+    uint32_t type;              /* BLK_T_IN or BLK_T_OUT. */
+    uint32_t reserved;
+    uint64_t sector;            /* First sector. */
+  };
+
+/* An in-flight request.  Slot I always uses descriptors 3*I,
+   3*I+1, and 3*I+2, for the header, the data, and the status
+   byte, respectively. */
+struct slot
+  {
+    struct blk_header header;   /* Request header, read by device. */
+    uint8_t status;             /* BLK_S_*, written by device. */
+    struct disk_request *request;       /* Request, or null if free. */
+  };
+
+/* Maximum number of requests outstanding on one device. */
+#define MAX_SLOTS (PGSIZE / sizeof (struct slot))
+
+/* A virtio block device. */
+struct virtio_blk
+  {
+    struct pci_dev *pci;        /* PCI function. */
+    uint16_t port;              /* Base of I/O port registers. */
+    struct disk *disk;          /* Disk registered for device. */
+
+    uint16_t queue_size;        /* Descriptors in queue. */
+    struct vring_desc *desc;    /* Descriptor table. */
+    struct vring_avail *avail;  /* Available ring. */
+    struct vring_used *used;    /* Used ring. */
+    uint16_t last_used;         /* Used ring entries consumed. */
+
+    struct slot *slots;         /* In-flight requests. */
+    size_t slot_cnt;            /* Number of elements in SLOTS. */
+    struct list pending;        /* Requests waiting for a free slot. */
+  };
+
+/* Devices found. */
+#define MAX_DEVICES 3
+static struct virtio_blk *devices[MAX_DEVICES];
+static size_t device_cnt;
+
+/* Roles that virtio disks may fill, in order of preference. */
+static const int roles[][2] = {{0, 1}, {1, 0}, {1, 1}};
+
+static bool probe (struct pci_dev *);
+static void submit (struct disk_request *);
+static bool start_request (struct virtio_blk *, struct disk_request *);
+static void interrupt_handler (struct intr_frame *);
+
+/* Operations for virtio disks. */
+static const struct disk_operations virtio_blk_operations = {submit};
+
+/* Finds and initializes virtio block devices.  Must be called
+   after disk_init(), so that IDE disks have already claimed
+   their roles. */
+void
+virtio_blk_init (void)
+{
+  struct pci_dev *pci;
+  size_t i;
+
+  for (i = 0; (pci = pci_find (VIRTIO_VENDOR_ID, VIRTIO_BLK_DEVICE_ID, i))
+         != NULL; i++)
+    if (device_cnt >= MAX_DEVICES)
+      printf ("vd: too many virtio disks, ignoring\n");
+    else if (!probe (pci))
+      printf ("vd%zu: initialization failed\n", device_cnt);
+}
+
+/* Initializes virtio block device PCI, registers a disk for it,
+   and gives the disk a role if one is free.  Returns true if
+   successful, false on failure. */
+static bool
+probe (struct pci_dev *pci)
+{
+  struct virtio_blk *vb;
+  size_t ring_size, desc_size, i;
+  uint32_t port, cap_lo, cap_hi;
+  uint64_t capacity;
+  bool is_io;
+  char name[8];
+  void *ring;
+
+  port = pci_get_bar (pci, 0, &is_io);
+  if (!is_io)
+    return false;
+  pci_enable (pci, PCI_CMD_IO | PCI_CMD_MASTER);
+
+  /* Reset device, then tell it we know how to drive it.  We do
+     not accept any optional features. */
+  outb (port + REG_STATUS, 0);
+  outb (port + REG_STATUS, STA_ACKNOWLEDGE);
+  outb (port + REG_STATUS, STA_ACKNOWLEDGE | STA_DRIVER);
+  inl (port + REG_HOST_FEATURES);
+  outl (port + REG_GUEST_FEATURES, 0);
+
+  /* Set up queue 0, the only queue of a block device. */
+  vb = malloc (sizeof *vb);
+  if (vb == NULL)
+    goto fail;
+  outw (port + REG_QUEUE_SELECT, 0);
+  vb->pci = pci;
+  vb->port = port;
+  vb->queue_size = inw (port + REG_QUEUE_SIZE);
+  if (vb->queue_size < 3)
+    goto fail_free;
+  desc_size = ROUND_UP (vb->queue_size * sizeof (struct vring_desc)
+                        + sizeof (struct vring_avail)
+                        + vb->queue_size * sizeof (uint16_t),
+                        VRING_ALIGN);
+  ring_size = desc_size + sizeof (struct vring_used)
+              + vb->queue_size * sizeof (struct vring_used_elem);
+  ring = palloc_get_multiple (PAL_ZERO, DIV_ROUND_UP (ring_size, PGSIZE));
+  if (ring == NULL)
+    goto fail_free;
+  vb->desc = ring;
+  vb->avail = (struct vring_avail *) (vb->desc + vb->queue_size);
+  vb->used = (struct vring_used *) ((uint8_t *) ring + desc_size);
+  vb->last_used = 0;
+
+  vb->slots = palloc_get_page (PAL_ZERO);
+  if (vb->slots == NULL)
+    goto fail_free_ring;
+  vb->slot_cnt = vb->queue_size / 3;
+  if (vb->slot_cnt > MAX_SLOTS)
+    vb->slot_cnt = MAX_SLOTS;
+  list_init (&vb->pending);
+
+  /* Link each slot's descriptors into a chain once and for all.
+     The header and status descriptors never change. */
+  for (i = 0; i < vb->slot_cnt; i++)
+    {
+      struct vring_desc *d = &vb->desc[i * 3];
+      struct slot *s = &vb->slots[i];
+
+      d[0].addr = vtop (&s->header);
+      d[0].len = sizeof s->header;
+      d[0].flags = DESC_NEXT;
+      d[0].next = i * 3 + 1;
+      d[1].next = i * 3 + 2;
+      d[2].addr = vtop (&s->status);
+      d[2].len = sizeof s->status;
+      d[2].flags = DESC_WRITE;
+    }
+  outl (port + REG_QUEUE_PFN, vtop (ring) / PGSIZE);
+
+  /* Register disk. */
+  cap_lo = inl (port + REG_CAPACITY);
+  cap_hi = inl (port + REG_CAPACITY + 4);
+  capacity = ((uint64_t) cap_hi << 32) | cap_lo;
+  if (capacity > (disk_sector_t) -1)
+    capacity = (disk_sector_t) -1;
+  snprintf (name, sizeof name, "vd%zu", device_cnt);
+  vb->disk = disk_register (name, capacity, &virtio_blk_operations, vb);
+  if (vb->disk == NULL)
+    goto fail_free_slots;
+  printf ("%s: detected %'"PRIu64" sector (%"PRIu64" MB) virtio disk, "
+          "irq %d\n", name, capacity,
+          capacity / (1024 / DISK_SECTOR_SIZE * 1024), pci->irq);
+
+  /* Hook up interrupt, unless another device on the same line
+     already did. */
+  for (i = 0; i < device_cnt; i++)
+    if (devices[i]->pci->irq == pci->irq)
+      break;
+  if (i >= device_cnt)
+    intr_register_ext (0x20 + pci->irq, interrupt_handler, "virtio-blk");
+  devices[device_cnt++] = vb;
+
+  outb (port + REG_STATUS, STA_ACKNOWLEDGE | STA_DRIVER | STA_DRIVER_OK);
+
+  /* Take the first free role. */
+  for (i = 0; i < sizeof roles / sizeof *roles; i++)
+    if (disk_get (roles[i][0], roles[i][1]) == NULL)
+      {
+        disk_set_role (vb->disk, roles[i][0], roles[i][1]);
+        break;
+      }
+  return true;
+
+ fail_free_slots:
+  palloc_free_page (vb->slots);
+ fail_free_ring:
+  palloc_free_multiple (ring, DIV_ROUND_UP (ring_size, PGSIZE));
+ fail_free:
+  free (vb);
+ fail:
+  outb (port + REG_STATUS, STA_FAILED);
+  return false;
+}
+
+/* Starts request R on its virtio disk, or queues it to start
+   once a slot frees up. */
+static void
+submit (struct disk_request *r)
+{
+  struct virtio_blk *vb = disk_aux (r->disk);
+  enum intr_level old_level = intr_disable ();
+
+  if (!list_empty (&vb->pending) || !start_request (vb, r))
+    list_push_back (&vb->pending, &r->elem);
+  intr_set_level (old_level);
+}
+
+/* Hands request R to device VB, if a slot is free.  Returns true
+   if successful, false if all slots are in use.  Must be called
+   with interrupts off. */
+static bool
+start_request (struct virtio_blk *vb, struct disk_request *r)
+{
+  struct vring_desc *d;
+  struct slot *s;
+  size_t i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < vb->slot_cnt; i++)
+    if (vb->slots[i].request == NULL)
+      break;
+  if (i >= vb->slot_cnt)
+    return false;
+
+  s = &vb->slots[i];
+  s->request = r;
+  s->header.type = r->write ? BLK_T_OUT : BLK_T_IN;
+  s->header.sector = r->sector;
+  s->status = 0xff;
+
+  d = &vb->desc[i * 3 + 1];
+  d->addr = vtop (r->buffer);
+  d->len = r->sector_cnt * DISK_SECTOR_SIZE;
+  d->flags = DESC_NEXT | (r->write ? 0 : DESC_WRITE);
+
+  /* The device may look at the ring entry as soon as it sees
+     the index change, so keep the compiler from reordering. */
+  vb->avail->ring[vb->avail->idx % vb->queue_size] = i * 3;
+  barrier ();
+  vb->avail->idx++;
+  barrier ();
+  outw (vb->port + REG_QUEUE_NOTIFY, 0);
+  return true;
+}
+
+/* Completes the requests that device VB has finished, then
+   starts as many pending requests as will fit. */
+static void
+service_device (struct virtio_blk *vb)
+{
+  while (vb->last_used != vb->used->idx)
+    {
+      struct vring_used_elem *e;
+      struct disk_request *r;
+      struct slot *s;
+
+      barrier ();
+      e = &vb->used->ring[vb->last_used++ % vb->queue_size];
+      ASSERT (e->id % 3 == 0 && e->id / 3 < vb->slot_cnt);
+      s = &vb->slots[e->id / 3];
+      r = s->request;
+      s->request = NULL;
+      if (s->status != BLK_S_OK)
+        PANIC ("virtio-blk: status %d %s sector %"PRDSNu,
+               s->status, r->write ? "writing" : "reading", r->sector);
+      disk_request_done (r);
+    }
+
+  while (!list_empty (&vb->pending))
+    {
+      struct disk_request *r = list_entry (list_front (&vb->pending),
+                                           struct disk_request, elem);
+      if (!start_request (vb, r))
+        break;
+      list_pop_front (&vb->pending);
+    }
+}
+
+/* Virtio interrupt handler.  Services each device on the
+   interrupt line that has an interrupt pending. */
+static void
+interrupt_handler (struct intr_frame *f)
+{
+  size_t i;
+
+  for (i = 0; i < device_cnt; i++)
+    {
+      struct virtio_blk *vb = devices[i];
+      if (f->vec_no == 0x20u + vb->pci->irq
+          && (inb (vb->port + REG_ISR) & 1) != 0)
+        service_device (vb);
+    }
+}
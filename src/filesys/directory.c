@@ -1,6 +1,9 @@
 #include "filesys/directory.h"
+#include <round.h>
 #include <stdio.h>
 #include <string.h>
+#include <dirent.h>
+#include <hash.h>
 #include <list.h>
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
@@ -21,12 +24,88 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
-/* Creates a directory with space for ENTRY_CNT entries in the
-   given SECTOR.  Returns true if successful, false on failure. */
+/* Directory entry cache.
+
+   Resolving a path looks up each of its components in turn, and
+   dir_lookup() finds a name by reading its directory's entries
+   one by one, so long paths in big directories are slow to
+   resolve.  The cache remembers, for the DCACHE_SIZE most
+   recently looked up names, the inode sector that the name maps
+   to in a given directory.  Only successful lookups are cached,
+   and dir_remove() drops the entry for a name it removes, so a
+   cached entry is always current.  "." and ".." are not cached,
+   since they are always the first two entries anyway. */
+#define DCACHE_SIZE 64
+
+/* A cached directory entry. */
+struct dcache_entry
+  {
+    struct hash_elem hash_elem;         /* Element in `dcache'. */
+    struct list_elem lru_elem;          /* Element in `dcache_lru'. */
+    disk_sector_t dir_sector;           /* Directory's inode sector. */
+    char name[NAME_MAX + 1];            /* Name in that directory. */
+    disk_sector_t inode_sector;         /* Inode sector NAME maps to. */
+    bool in_use;                        /* In `dcache'? */
+  };
+
+static struct dcache_entry dcache_entries[DCACHE_SIZE];
+static struct hash dcache;              /* Entries in use. */
+static struct list dcache_lru;          /* All entries, most recent first. */
+
+/* Statistics. */
+static long long dcache_hit_cnt;
+static long long dcache_miss_cnt;
+
+static hash_hash_func dcache_hash;
+static hash_less_func dcache_less;
+static struct dcache_entry *dcache_find (disk_sector_t dir_sector,
+                                         const char *name);
+static void dcache_insert (disk_sector_t dir_sector, const char *name,
+                           disk_sector_t inode_sector);
+static bool is_dot (const char *name);
+
+/* Initializes the directory module. */
+void
+dir_init (void) 
+{
+  size_t i;
+
+  if (!hash_init (&dcache, dcache_hash, dcache_less, NULL))
+    PANIC ("directory cache allocation failed");
+  list_init (&dcache_lru);
+  for (i = 0; i < DCACHE_SIZE; i++)
+    list_push_back (&dcache_lru, &dcache_entries[i].lru_elem);
+}
+
+/* Prints directory cache statistics. */
+void
+dir_print_stats (void) 
+{
+  printf ("Directory cache: %lld hits, %lld misses\n",
+          dcache_hit_cnt, dcache_miss_cnt);
+}
+
+/* Creates a directory with space for ENTRY_CNT entries, besides
+   "." and "..", in the given SECTOR.  Its ".." entry refers to
+   PARENT_SECTOR; the root directory is its own parent.
+   Returns true if successful, false on failure. */
 bool
-dir_create (disk_sector_t sector, size_t entry_cnt) 
+dir_create (disk_sector_t sector, disk_sector_t parent_sector,
+            size_t entry_cnt) 
 {
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+  struct dir *dir;
+  bool success;
+
+  if (!inode_create (sector, (entry_cnt + 2) * sizeof (struct dir_entry),
+                     INODE_META | INODE_DIR))
+    return false;
+
+  dir = dir_open (inode_open (sector));
+  success = (dir != NULL
+             && dir_add (dir, ".", sector)
+             && dir_add (dir, "..", parent_sector));
+  dir_close (dir);
+  return success;
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -119,13 +198,26 @@ bool
 dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode) 
 {
+  disk_sector_t dir_sector;
+  struct dcache_entry *ce;
   struct dir_entry e;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
+  dir_sector = inode_get_inumber (dir->inode);
+  ce = dcache_find (dir_sector, name);
+  if (ce != NULL)
+    {
+      dcache_hit_cnt++;
+      *inode = inode_open (ce->inode_sector);
+    }
+  else if (lookup (dir, name, &e, NULL))
+    {
+      dcache_miss_cnt++;
+      dcache_insert (dir_sector, name, e.inode_sector);
+      *inode = inode_open (e.inode_sector);
+    }
   else
     *inode = NULL;
 
@@ -136,8 +228,8 @@ dir_lookup (const struct dir *dir, const char *name,
    file by that name.  The file's inode is in sector
    INODE_SECTOR.
    Returns true if successful, false on failure.
-   Fails if NAME is invalid (i.e. too long) or a disk or memory
-   error occurs. */
+   Fails if NAME is invalid (i.e. too long), if DIR has been
+   removed, or if a disk or memory error occurs. */
 bool
 dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) 
 {
@@ -152,6 +244,10 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector)
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
+  /* Removed directories stay empty. */
+  if (inode_is_removed (dir->inode))
+    return false;
+
   /* Check that NAME is not in use. */
   if (lookup (dir, name, NULL, NULL))
     goto done;
@@ -179,12 +275,15 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector)
 }
 
 /* Removes any entry for NAME in DIR.
-   Returns true if successful, false on failure,
-   which occurs only if there is no file with the given NAME. */
+   Returns true if successful, false on failure, which occurs if
+   there is no file with the given NAME, if NAME is "." or "..",
+   or if NAME is a directory that is not empty or that is open
+   elsewhere, including as a process's working directory. */
 bool
 dir_remove (struct dir *dir, const char *name) 
 {
   struct dir_entry e;
+  struct dcache_entry *ce;
   struct inode *inode = NULL;
   bool success = false;
   off_t ofs;
@@ -193,7 +292,7 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (name != NULL);
 
   /* Find directory entry. */
-  if (!lookup (dir, name, &e, &ofs))
+  if (is_dot (name) || !lookup (dir, name, &e, &ofs))
     goto done;
 
   /* Open inode. */
@@ -201,12 +300,36 @@ dir_remove (struct dir *dir, const char *name)
   if (inode == NULL)
     goto done;
 
+  /* Only remove directories that are empty and not in use. */
+  if (inode_is_dir (inode))
+    {
+      struct dir *victim;
+      char child[NAME_MAX + 1];
+      bool empty;
+
+      if (inode_open_cnt (inode) > 1)
+        goto done;
+      victim = dir_open (inode_reopen (inode));
+      if (victim == NULL)
+        goto done;
+      empty = !dir_readdir (victim, child);
+      dir_close (victim);
+      if (!empty)
+        goto done;
+    }
+
   /* Erase directory entry. */
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
 
   /* Remove inode. */
+  ce = dcache_find (inode_get_inumber (dir->inode), name);
+  if (ce != NULL)
+    {
+      hash_delete (&dcache, &ce->hash_elem);
+      ce->in_use = false;
+    }
   inode_remove (inode);
   success = true;
 
@@ -215,9 +338,9 @@ dir_remove (struct dir *dir, const char *name)
   return success;
 }
 
-/* Reads the next directory entry in DIR and stores the name in
-   NAME.  Returns true if successful, false if the directory
-   contains no more entries. */
+/* Reads the next directory entry in DIR, other than "." and
+   "..", and stores the name in NAME.  Returns true if successful,
+   false if the directory contains no more entries. */
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
@@ -226,7 +349,7 @@ dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
   while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
     {
       dir->pos += sizeof e;
-      if (e.in_use)
+      if (e.in_use && !is_dot (e.name))
         {
           strlcpy (name, e.name, NAME_MAX + 1);
           return true;
@@ -234,3 +357,140 @@ dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
     }
   return false;
 }
+
+/* Reads up to CNT entries of DIR, other than "." and "..", into
+   ENTRIES, along with the inode number, size, and type of the
+   file that each one names.  Returns the number of entries
+   stored, which is 0 once DIR contains no more entries.
+   DIR's entries are read a sector at a time, starting from the
+   sector that contains DIR's position, so that listing a
+   directory reads each of its sectors about once.  An entry that
+   begins in one sector and ends in the next is read along with
+   the first. */
+size_t
+dir_readdir_plus (struct dir *dir, struct dirent *entries, size_t cnt)
+{
+  uint8_t *buffer;
+  size_t stored = 0;
+
+  buffer = malloc (2 * DISK_SECTOR_SIZE);
+  if (buffer == NULL)
+    return 0;
+
+  while (stored < cnt)
+    {
+      /* Read the sector that contains DIR->pos, and the next one
+         if the last entry that begins in it runs over. */
+      off_t start = ROUND_DOWN (dir->pos, DISK_SECTOR_SIZE);
+      off_t end = start + DISK_SECTOR_SIZE;
+      off_t size = (ROUND_UP (ROUND_UP (end, sizeof (struct dir_entry)),
+                              DISK_SECTOR_SIZE) - start);
+      off_t bytes = inode_read_at (dir->inode, buffer, size, start);
+
+      /* Go through the entries that begin in the first sector. */
+      while (stored < cnt && dir->pos < end
+             && dir->pos + (off_t) sizeof (struct dir_entry) <= start + bytes)
+        {
+          struct dir_entry *e
+            = (struct dir_entry *) (buffer + (dir->pos - start));
+          struct dirent *d = &entries[stored];
+          struct inode *inode;
+
+          dir->pos += sizeof *e;
+          if (!e->in_use || is_dot (e->name))
+            continue;
+
+          inode = inode_open (e->inode_sector);
+          d->inumber = e->inode_sector;
+          d->size = inode != NULL ? inode_length (inode) : 0;
+          d->is_dir = inode != NULL && inode_is_dir (inode);
+          strlcpy (d->name, e->name, sizeof d->name);
+          inode_close (inode);
+          stored++;
+        }
+
+      /* Stop at the end of the directory. */
+      if (dir->pos < end)
+        break;
+    }
+  free (buffer);
+  return stored;
+}
+
+/* Returns a hash value for directory cache entry E. */
+static unsigned
+dcache_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct dcache_entry *ce
+    = hash_entry (e, struct dcache_entry, hash_elem);
+  return hash_string (ce->name) ^ hash_int (ce->dir_sector);
+}
+
+/* Returns true if directory cache entry A precedes B. */
+static bool
+dcache_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED)
+{
+  const struct dcache_entry *a
+    = hash_entry (a_, struct dcache_entry, hash_elem);
+  const struct dcache_entry *b
+    = hash_entry (b_, struct dcache_entry, hash_elem);
+
+  if (a->dir_sector != b->dir_sector)
+    return a->dir_sector < b->dir_sector;
+  return strcmp (a->name, b->name) < 0;
+}
+
+/* Returns the directory cache entry for NAME in the directory
+   whose inode is in DIR_SECTOR, marking it most recently used,
+   or a null pointer if there is none. */
+static struct dcache_entry *
+dcache_find (disk_sector_t dir_sector, const char *name)
+{
+  struct dcache_entry key, *ce;
+  struct hash_elem *e;
+
+  if (strlen (name) > NAME_MAX)
+    return NULL;
+  key.dir_sector = dir_sector;
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&dcache, &key.hash_elem);
+  if (e == NULL)
+    return NULL;
+
+  ce = hash_entry (e, struct dcache_entry, hash_elem);
+  list_remove (&ce->lru_elem);
+  list_push_front (&dcache_lru, &ce->lru_elem);
+  return ce;
+}
+
+/* Caches that NAME maps to INODE_SECTOR in the directory whose
+   inode is in DIR_SECTOR, evicting the least recently used
+   entry. */
+static void
+dcache_insert (disk_sector_t dir_sector, const char *name,
+               disk_sector_t inode_sector)
+{
+  struct dcache_entry *ce;
+
+  if (is_dot (name))
+    return;
+
+  ce = list_entry (list_back (&dcache_lru), struct dcache_entry, lru_elem);
+  if (ce->in_use)
+    hash_delete (&dcache, &ce->hash_elem);
+  ce->dir_sector = dir_sector;
+  strlcpy (ce->name, name, sizeof ce->name);
+  ce->inode_sector = inode_sector;
+  ce->in_use = true;
+  hash_insert (&dcache, &ce->hash_elem);
+  list_remove (&ce->lru_elem);
+  list_push_front (&dcache_lru, &ce->lru_elem);
+}
+
+/* Returns true if NAME is "." or "..". */
+static bool
+is_dot (const char *name)
+{
+  return !strcmp (name, ".") || !strcmp (name, "..");
+}
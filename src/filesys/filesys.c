@@ -6,11 +6,18 @@
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
+#include "filesys/journal.h"
+#include "filesys/tmpfs.h"
 #include "devices/disk.h"
+#include "threads/thread.h"
 
 /* The disk that contains the file system. */
 struct disk *filesys_disk;
 
+/* If true, new files are created with INODE_COMPRESSED. */
+bool filesys_compress;
+
+static struct dir *resolve (const char *path, char name[NAME_MAX + 1]);
 static void do_format (void);
 
 /* Initializes the file system module.
@@ -23,11 +30,13 @@ filesys_init (bool format)
     PANIC ("hd0:1 (hdb) not present, file system initialization failed");
 
   inode_init ();
+  dir_init ();
   free_map_init ();
 
   if (format) 
     do_format ();
 
+  journal_init ();
   free_map_open ();
 }
 
@@ -36,25 +45,39 @@ filesys_init (bool format)
 void
 filesys_done (void) 
 {
+  inode_flush_all ();
+  journal_done ();
   free_map_close ();
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
    Returns true if successful, false otherwise.
-   Fails if a file named NAME already exists,
-   or if internal memory allocation fails. */
+   Fails if a file named NAME already exists, if a directory in
+   NAME does not exist, or if internal memory allocation fails.
+   Names starting with TMPFS_PREFIX are created in tmpfs, if it
+   is enabled. */
 bool
 filesys_create (const char *name, off_t initial_size) 
 {
   disk_sector_t inode_sector = 0;
-  struct dir *dir = dir_open_root ();
-  bool success = (dir != NULL
-                  && free_map_allocate (1, &inode_sector)
-                  && inode_create (inode_sector, initial_size)
-                  && dir_add (dir, name, inode_sector));
+  char base[NAME_MAX + 1];
+  struct dir *dir;
+  bool success;
+
+  if (tmpfs_match (name) != NULL)
+    return tmpfs_create (tmpfs_match (name), initial_size);
+
+  journal_begin ();
+  dir = resolve (name, base);
+  success = (dir != NULL
+             && free_map_allocate (1, &inode_sector)
+             && inode_create (inode_sector, initial_size,
+                              filesys_compress ? INODE_COMPRESSED : 0)
+             && dir_add (dir, base, inode_sector));
   if (!success && inode_sector != 0) 
     free_map_release (inode_sector, 1);
   dir_close (dir);
+  journal_end ();
 
   return success;
 }
@@ -63,42 +86,239 @@ filesys_create (const char *name, off_t initial_size)
    Returns the new file if successful or a null pointer
    otherwise.
    Fails if no file named NAME exists,
-   or if an internal memory allocation fails. */
+   or if an internal memory allocation fails.
+   NAME may name a directory, which is opened like a file; use
+   dir_open() on the file's inode to read its entries. */
 struct file *
 filesys_open (const char *name)
 {
-  struct dir *dir = dir_open_root ();
+  char base[NAME_MAX + 1];
+  struct dir *dir;
   struct inode *inode = NULL;
 
+  if (tmpfs_match (name) != NULL)
+    return file_open (tmpfs_open (tmpfs_match (name)));
+
+  dir = resolve (name, base);
   if (dir != NULL)
-    dir_lookup (dir, name, &inode);
+    dir_lookup (dir, base, &inode);
   dir_close (dir);
 
   return file_open (inode);
 }
 
-/* Deletes the file named NAME.
+/* Deletes the file or empty directory named NAME.
    Returns true if successful, false on failure.
-   Fails if no file named NAME exists,
-   or if an internal memory allocation fails. */
+   Fails if no file named NAME exists, if NAME is a directory
+   that is not empty or is open, or if an internal memory
+   allocation fails. */
 bool
 filesys_remove (const char *name) 
 {
-  struct dir *dir = dir_open_root ();
-  bool success = dir != NULL && dir_remove (dir, name);
+  char base[NAME_MAX + 1];
+  struct dir *dir;
+  bool success;
+
+  if (tmpfs_match (name) != NULL)
+    return tmpfs_remove (tmpfs_match (name));
+
+  journal_begin ();
+  dir = resolve (name, base);
+  success = dir != NULL && dir_remove (dir, base);
   dir_close (dir); 
+  journal_end ();
 
   return success;
 }
 
+/* Creates a file named DST_NAME that is a copy of the file named
+   SRC_NAME.  The copy shares SRC_NAME's data on disk until one of
+   them is written, so this takes the same time for any file size.
+   Returns true if successful, false otherwise.
+   Fails if SRC_NAME does not exist, if DST_NAME already exists,
+   if either is in tmpfs, or if internal memory allocation
+   fails. */
+bool
+filesys_clone (const char *src_name, const char *dst_name) 
+{
+  disk_sector_t inode_sector = 0;
+  char src_base[NAME_MAX + 1], dst_base[NAME_MAX + 1];
+  struct inode *src = NULL;
+  struct inode *dst = NULL;
+  struct dir *src_dir, *dir;
+  bool success;
+
+  if (tmpfs_match (src_name) != NULL || tmpfs_match (dst_name) != NULL)
+    return false;
+
+  journal_begin ();
+  src_dir = resolve (src_name, src_base);
+  dir = resolve (dst_name, dst_base);
+  success = (src_dir != NULL && dir != NULL
+             && dir_lookup (src_dir, src_base, &src)
+             && !inode_is_dir (src)
+             && !dir_lookup (dir, dst_base, &dst)
+             && free_map_allocate (1, &inode_sector));
+  if (success && !inode_clone (src, inode_sector))
+    {
+      free_map_release (inode_sector, 1);
+      success = false;
+    }
+  else if (success && !dir_add (dir, dst_base, inode_sector))
+    {
+      /* Drop the clone again, along with its share of the data. */
+      dst = inode_open (inode_sector);
+      if (dst != NULL)
+        inode_remove (dst);
+      success = false;
+    }
+  inode_close (dst);
+  inode_close (src);
+  dir_close (dir);
+  dir_close (src_dir);
+  journal_end ();
+
+  return success;
+}
+
+/* Creates a directory named NAME.
+   Returns true if successful, false otherwise.
+   Fails if a file named NAME already exists, if a directory in
+   NAME does not exist, or if internal memory allocation fails. */
+bool
+filesys_mkdir (const char *name) 
+{
+  disk_sector_t inode_sector = 0;
+  char base[NAME_MAX + 1];
+  struct dir *dir;
+  struct inode *inode;
+  bool success;
+
+  if (tmpfs_match (name) != NULL)
+    return false;
+
+  journal_begin ();
+  dir = resolve (name, base);
+  success = (dir != NULL
+             && free_map_allocate (1, &inode_sector)
+             && dir_create (inode_sector,
+                            inode_get_inumber (dir_get_inode (dir)), 16));
+  if (!success && inode_sector != 0) 
+    free_map_release (inode_sector, 1);
+  else if (success && !dir_add (dir, base, inode_sector))
+    {
+      /* Drop the new directory again, along with its entries. */
+      inode = inode_open (inode_sector);
+      if (inode != NULL)
+        inode_remove (inode);
+      inode_close (inode);
+      success = false;
+    }
+  dir_close (dir);
+  journal_end ();
+
+  return success;
+}
+
+/* Makes the directory named NAME the running thread's working
+   directory, against which relative names are resolved.
+   Returns true if successful, false if NAME does not exist or is
+   not a directory. */
+bool
+filesys_chdir (const char *name) 
+{
+  struct thread *t = thread_current ();
+  char base[NAME_MAX + 1];
+  struct dir *dir;
+  struct inode *inode = NULL;
+
+  dir = resolve (name, base);
+  if (dir != NULL)
+    dir_lookup (dir, base, &inode);
+  dir_close (dir);
+  if (inode == NULL || !inode_is_dir (inode))
+    {
+      inode_close (inode);
+      return false;
+    }
+
+  dir = dir_open (inode);
+  if (dir == NULL)
+    return false;
+  dir_close (t->cwd);
+  t->cwd = dir;
+  return true;
+}
+
+/* Opens the directory that holds the last component of PATH and
+   stores that component in NAME.  Absolute paths are resolved
+   from the root directory, relative paths from the running
+   thread's working directory, or the root if it has none.  A
+   path with no last component, such as "/", names the directory
+   itself, as ".".  Returns a null pointer if PATH is empty, if a
+   component is longer than NAME_MAX, or if a component before
+   the last does not exist or is not a directory. */
+static struct dir *
+resolve (const char *path, char name[NAME_MAX + 1])
+{
+  struct thread *t = thread_current ();
+  struct dir *dir;
+
+  if (*path == '\0')
+    return NULL;
+  if (*path == '/' || t->cwd == NULL)
+    dir = dir_open_root ();
+  else
+    dir = dir_reopen (t->cwd);
+
+  strlcpy (name, ".", NAME_MAX + 1);
+  while (dir != NULL)
+    {
+      struct inode *inode;
+      size_t len;
+
+      /* Copy the next component into NAME. */
+      while (*path == '/')
+        path++;
+      len = strcspn (path, "/");
+      if (len > NAME_MAX)
+        break;
+      if (len > 0)
+        {
+          memcpy (name, path, len);
+          name[len] = '\0';
+          path += len;
+        }
+
+      /* Stop at the last component, ignoring trailing slashes. */
+      while (*path == '/')
+        path++;
+      if (*path == '\0')
+        return dir;
+
+      /* Descend into the directory that NAME names. */
+      dir_lookup (dir, name, &inode);
+      dir_close (dir);
+      if (inode == NULL || !inode_is_dir (inode))
+        {
+          inode_close (inode);
+          return NULL;
+        }
+      dir = dir_open (inode);
+    }
+  dir_close (dir);
+  return NULL;
+}
+
 /* Formats the file system. */
 static void
 do_format (void)
 {
   printf ("Formatting file system...");
   free_map_create ();
-  if (!dir_create (ROOT_DIR_SECTOR, 16))
+  if (!dir_create (ROOT_DIR_SECTOR, ROOT_DIR_SECTOR, 16))
     PANIC ("root directory creation failed");
+  journal_create ();
   free_map_close ();
   printf ("done.\n");
 }
@@ -1,22 +1,156 @@
 #include "filesys/free-map.h"
-#include <bitmap.h>
 #include <debug.h>
+#include <round.h>
+#include <string.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "threads/malloc.h"
+
+/* The free map records which sectors are in use, one bit per
+   sector, in the free map file.  So that mounting takes the same
+   time and memory however large the disk, the map is never read
+   in as a whole.  Instead, sectors are divided into groups of
+   GROUP_SECTORS, whose bits fill one sector of the file, and the
+   file holds:
+
+     - A header sector with the total number of free sectors.
+
+     - Summary sectors, giving the number of free sectors in
+       each group.
+
+     - One bitmap sector per group.
+
+   Searches use the summaries to skip over full groups, and to
+   pass over entirely free groups without reading their bitmaps.
+   Sectors of the file are read as needed into a small cache.
+   Every change is written through to the file right away, so it
+   is journaled along with the operation that made it.
+
+   Until the free map file exists, while formatting, sectors are
+   handed out in order starting just past the system sectors.
+
+   A reservation is a run of sectors allocated for data that no
+   inode refers to yet, such as delayed data that has not been
+   written back.  A crash would leave such sectors allocated but
+   owned by nobody, so each reservation is also listed in the
+   header, in the same transaction as its allocation, and
+   free_map_open() releases any that a crash left there. */
+
+/* Sectors per group: the bits in one sector. */
+#define GROUP_SECTORS (DISK_SECTOR_SIZE * 8)
+
+/* Groups per summary sector. */
+#define SUMMARY_GROUPS (DISK_SECTOR_SIZE / sizeof (uint16_t))
+
+/* Most groups whose bitmaps set_range() changes in one
+   piece. */
+#define SET_RANGE_GROUPS 32
+
+/* Identifies a free map header. */
+#define FREE_MAP_MAGIC 0x46524545
+
+/* Maximum number of reservations listed in the header. */
+#define RESERVED_MAX 62
+
+/* Free map header, in the first sector of the free map file.
+   Must be exactly DISK_SECTOR_SIZE bytes long. */
+struct free_map_header
+  {
+    unsigned magic;             /* FREE_MAP_MAGIC. */
+    uint32_t group_cnt;         /* Number of groups. */
+    uint32_t free_cnt;          /* Number of free sectors. */
+    uint32_t reserved_cnt;      /* Number of reservations. */
+    struct
+      {
+        disk_sector_t start;    /* First sector. */
+        uint32_t cnt;           /* Number of sectors. */
+      }
+    reserved[RESERVED_MAX];     /* Reservations. */
+  };
+
+/* Number of sectors of the free map file cached in memory. */
+#define CACHE_CNT 8
+
+/* A cached sector of the free map file. */
+struct cache_block
+  {
+    size_t idx;                 /* Sector index within file. */
+    bool valid;                 /* Holds data? */
+    unsigned stamp;             /* Time of last use, for LRU. */
+    uint8_t data[DISK_SECTOR_SIZE];     /* Contents. */
+  };
 
 static struct file *free_map_file;   /* Free map file. */
-static struct bitmap *free_map;      /* Free map, one bit per disk sector. */
+static struct cache_block cache[CACHE_CNT];     /* Cached sectors. */
+static unsigned clock;               /* Stamps cache uses. */
+
+static size_t sector_cnt;            /* Sectors on disk. */
+static size_t group_cnt;             /* Groups on disk. */
+static size_t summary_cnt;           /* Summary sectors in file. */
+static size_t first_free_group;      /* No free sectors before this group. */
+static disk_sector_t boot_next;      /* Next sector to allocate, before
+                                        the free map file exists. */
+
+static size_t free_cnt;              /* Number of free sectors. */
+
+static void *get_block (size_t idx);
+static void put_block (size_t idx, const void *);
+static bool find_run (size_t cnt, disk_sector_t *startp);
+static bool range_free (disk_sector_t, size_t cnt);
+static void set_range (disk_sector_t, size_t cnt, bool used);
+static bool add_reservation (disk_sector_t, size_t cnt, bool merge);
+static void release_used (disk_sector_t, size_t cnt);
+static size_t group_free (size_t group);
+
+/* Returns the index within the free map file of GROUP's summary
+   sector. */
+static inline size_t
+summary_block (size_t group)
+{
+  return 1 + group / SUMMARY_GROUPS;
+}
+
+/* Returns the index within the free map file of GROUP's bitmap
+   sector. */
+static inline size_t
+bitmap_block (size_t group)
+{
+  return 1 + summary_cnt + group;
+}
+
+/* Returns true if bit IDX in BITS is set. */
+static inline bool
+bit_test (const uint8_t *bits, size_t idx)
+{
+  return (bits[idx / 8] & (1u << (idx % 8))) != 0;
+}
+
+/* Sets bit IDX in BITS to VALUE. */
+static inline void
+bit_set (uint8_t *bits, size_t idx, bool value)
+{
+  if (value)
+    bits[idx / 8] |= 1u << (idx % 8);
+  else
+    bits[idx / 8] &= ~(1u << (idx % 8));
+}
 
 /* Initializes the free map. */
 void
-free_map_init (void) 
+free_map_init (void)
 {
-  free_map = bitmap_create (disk_size (filesys_disk));
-  if (free_map == NULL)
-    PANIC ("bitmap creation failed--disk is too large");
-  bitmap_mark (free_map, FREE_MAP_SECTOR);
-  bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  sector_cnt = disk_size (filesys_disk);
+  group_cnt = DIV_ROUND_UP (sector_cnt, GROUP_SECTORS);
+  summary_cnt = DIV_ROUND_UP (group_cnt, SUMMARY_GROUPS);
+  first_free_group = 0;
+
+  /* Sectors 0 through JOURNAL_SECTOR are always in use. */
+  ASSERT (FREE_MAP_SECTOR < JOURNAL_SECTOR
+          && ROOT_DIR_SECTOR < JOURNAL_SECTOR);
+  boot_next = JOURNAL_SECTOR + 1;
+  free_cnt = sector_cnt - boot_next;
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -24,61 +158,520 @@ free_map_init (void)
    Returns true if successful, false if all sectors were
    available. */
 bool
-free_map_allocate (size_t cnt, disk_sector_t *sectorp) 
+free_map_allocate (size_t cnt, disk_sector_t *sectorp)
 {
-  disk_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  if (cnt > free_cnt)
+    return false;
+
+  if (free_map_file == NULL)
     {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      *sectorp = boot_next;
+      boot_next += cnt;
+      free_cnt -= cnt;
     }
-  if (sector != BITMAP_ERROR)
-    *sectorp = sector;
-  return sector != BITMAP_ERROR;
+  else if (find_run (cnt, sectorp))
+    set_range (*sectorp, cnt, true);
+  else
+    return false;
+  return true;
 }
 
-/* Makes CNT sectors starting at SECTOR available for use. */
+/* Allocates the CNT sectors starting at SECTOR, if all of them
+   are free.  Returns true if successful, false if any of them is
+   in use or lies beyond the end of the disk. */
+bool
+free_map_allocate_at (disk_sector_t sector, size_t cnt)
+{
+  if (free_map_file == NULL
+      || cnt > free_cnt
+      || sector > sector_cnt
+      || cnt > sector_cnt - sector
+      || !range_free (sector, cnt))
+    return false;
+  set_range (sector, cnt, true);
+  return true;
+}
+
+/* Makes CNT sectors starting at SECTOR available for use.
+   If the journal still holds unwritten contents for any of them,
+   they become available only after its next checkpoint. */
 void
 free_map_release (disk_sector_t sector, size_t cnt)
 {
-  ASSERT (bitmap_all (free_map, sector, cnt));
-  bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  ASSERT (free_map_file != NULL);
+  if (journal_defer_release (sector, cnt))
+    return;
+  set_range (sector, cnt, false);
+  if (sector / GROUP_SECTORS < first_free_group)
+    first_free_group = sector / GROUP_SECTORS;
 }
 
-/* Opens the free map file and reads it from disk. */
+/* Allocates CNT consecutive sectors, like free_map_allocate(),
+   as a reservation, and stores the first into *SECTORP.  Returns
+   true if successful, false if there is no such run or the
+   header has no room to list another reservation. */
+bool
+free_map_reserve (size_t cnt, disk_sector_t *sectorp)
+{
+  if (free_map_file == NULL
+      || cnt > free_cnt
+      || !find_run (cnt, sectorp)
+      || !add_reservation (*sectorp, cnt, false))
+    return false;
+  set_range (*sectorp, cnt, true);
+  return true;
+}
+
+/* Allocates the CNT sectors starting at SECTOR, like
+   free_map_allocate_at(), as a reservation.  If SECTOR follows
+   a reservation, the two are merged.  Returns true if
+   successful, false if any of the sectors is in use or the
+   header has no room to list another reservation. */
+bool
+free_map_reserve_at (disk_sector_t sector, size_t cnt)
+{
+  if (free_map_file == NULL
+      || cnt > free_cnt
+      || sector > sector_cnt
+      || cnt > sector_cnt - sector
+      || !range_free (sector, cnt)
+      || !add_reservation (sector, cnt, true))
+    return false;
+  set_range (sector, cnt, true);
+  return true;
+}
+
+/* Releases the CNT sectors starting at SECTOR, which must be a
+   whole reservation made by free_map_reserve() and any
+   free_map_reserve_at() calls that extended it, and stops
+   listing them as reserved. */
 void
-free_map_open (void) 
+free_map_unreserve (disk_sector_t sector, size_t cnt)
+{
+  struct free_map_header *h;
+  size_t i;
+
+  free_map_release (sector, cnt);
+
+  h = get_block (0);
+  for (i = 0; i < h->reserved_cnt; i++)
+    if (h->reserved[i].start == sector)
+      {
+        h->reserved[i] = h->reserved[--h->reserved_cnt];
+        break;
+      }
+  put_block (0, h);
+}
+
+/* Finds the longest run of free sectors, stores its first sector
+   into *STARTP, and returns its length, or returns 0 if no
+   sector is free.  If EXTENT_CNTP is nonnull, also stores the
+   number of separate runs of free sectors into *EXTENT_CNTP. */
+size_t
+free_map_largest (disk_sector_t *startp, size_t *extent_cntp)
 {
+  disk_sector_t run_start = 0;
+  size_t run_len = 0;
+  size_t longest = 0;
+  size_t extent_cnt = 0;
+  size_t group;
+
+  for (group = 0; group < group_cnt; group++)
+    {
+      size_t avail = group_free (group);
+      const uint8_t *bits = NULL;
+      size_t i;
+
+      if (avail > 0 && avail < GROUP_SECTORS)
+        bits = get_block (bitmap_block (group));
+      for (i = 0; i < GROUP_SECTORS; i++)
+        {
+          bool used = bits != NULL ? bit_test (bits, i) : avail == 0;
+
+          if (!used)
+            {
+              if (run_len++ == 0)
+                {
+                  run_start = group * GROUP_SECTORS + i;
+                  extent_cnt++;
+                }
+              if (run_len > longest)
+                {
+                  longest = run_len;
+                  *startp = run_start;
+                }
+            }
+          else
+            run_len = 0;
+        }
+    }
+
+  if (extent_cntp != NULL)
+    *extent_cntp = extent_cnt;
+  return longest;
+}
+
+/* Opens the free map file and reads its header from disk. */
+void
+free_map_open (void)
+{
+  struct free_map_header *h;
+
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
-  if (!bitmap_read (free_map, free_map_file))
-    PANIC ("can't read free map");
+
+  h = get_block (0);
+  if (h->magic != FREE_MAP_MAGIC || h->group_cnt != group_cnt)
+    PANIC ("free map is invalid or does not match disk size");
+  free_cnt = h->free_cnt;
+
+  /* Reclaim reservations that a crash left behind. */
+  if (h->reserved_cnt > 0)
+    {
+      journal_begin ();
+      while ((h = get_block (0))->reserved_cnt > 0)
+        {
+          size_t i = h->reserved_cnt - 1;
+          disk_sector_t start = h->reserved[i].start;
+          size_t cnt = h->reserved[i].cnt;
+
+          h->reserved_cnt--;
+          put_block (0, h);
+          release_used (start, cnt);
+        }
+      journal_end ();
+    }
 }
 
-/* Writes the free map to disk and closes the free map file. */
+/* Closes the free map file.  The free map is always up to date
+   on disk, so nothing needs to be written. */
 void
-free_map_close (void) 
+free_map_close (void)
 {
+  size_t i;
+
   file_close (free_map_file);
+  free_map_file = NULL;
+  for (i = 0; i < CACHE_CNT; i++)
+    cache[i].valid = false;
 }
 
 /* Creates a new free map file on disk and writes the free map to
-   it. */
+   it, marking the sectors allocated so far as in use. */
 void
-free_map_create (void) 
+free_map_create (void)
 {
+  struct free_map_header *h;
+  uint8_t *bits;
+  uint16_t *summary;
+  size_t group;
+
   /* Create inode. */
-  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
+  if (!inode_create (FREE_MAP_SECTOR,
+                     (1 + summary_cnt + group_cnt) * DISK_SECTOR_SIZE,
+                     INODE_META))
     PANIC ("free map creation failed");
-
-  /* Write bitmap to file. */
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
-  if (!bitmap_write (free_map, free_map_file))
+
+  /* Write bitmaps and summaries.  Sectors past the end of the
+     disk are marked in use, so that they are never allocated. */
+  bits = malloc (DISK_SECTOR_SIZE);
+  summary = malloc (DISK_SECTOR_SIZE);
+  h = calloc (1, sizeof *h);
+  if (bits == NULL || summary == NULL || h == NULL)
+    PANIC ("can't write free map");
+  for (group = 0; group < group_cnt; group++)
+    {
+      size_t avail = 0;
+      size_t i;
+
+      for (i = 0; i < GROUP_SECTORS; i++)
+        {
+          disk_sector_t sector = group * GROUP_SECTORS + i;
+          bool used = sector < boot_next || sector >= sector_cnt;
+          bit_set (bits, i, used);
+          if (!used)
+            avail++;
+        }
+      summary[group % SUMMARY_GROUPS] = avail;
+      put_block (bitmap_block (group), bits);
+
+      if (group % SUMMARY_GROUPS == SUMMARY_GROUPS - 1
+          || group == group_cnt - 1)
+        put_block (summary_block (group), summary);
+    }
+
+  /* Write header. */
+  h->magic = FREE_MAP_MAGIC;
+  h->group_cnt = group_cnt;
+  h->free_cnt = free_cnt;
+  put_block (0, h);
+
+  free (h);
+  free (summary);
+  free (bits);
+}
+
+/* Returns the contents of sector IDX of the free map file,
+   reading it into the cache if necessary.  The returned data is
+   valid only until the next call to get_block() or
+   put_block(). */
+static void *
+get_block (size_t idx)
+{
+  struct cache_block *b = NULL;
+  size_t i;
+
+  for (i = 0; i < CACHE_CNT; i++)
+    if (cache[i].valid && cache[i].idx == idx)
+      {
+        b = &cache[i];
+        break;
+      }
+    else if (b == NULL || !cache[i].valid
+             || (b->valid && cache[i].stamp < b->stamp))
+      b = &cache[i];
+
+  if (!b->valid || b->idx != idx)
+    {
+      off_t ofs = idx * DISK_SECTOR_SIZE;
+      if (file_read_at (free_map_file, b->data, DISK_SECTOR_SIZE, ofs)
+          != DISK_SECTOR_SIZE)
+        PANIC ("can't read free map");
+      b->idx = idx;
+      b->valid = true;
+    }
+  b->stamp = ++clock;
+  return b->data;
+}
+
+/* Writes DATA to sector IDX of the free map file, updating the
+   cache. */
+static void
+put_block (size_t idx, const void *data)
+{
+  off_t ofs = idx * DISK_SECTOR_SIZE;
+  size_t i;
+
+  for (i = 0; i < CACHE_CNT; i++)
+    if (cache[i].valid && cache[i].idx == idx && cache[i].data != data)
+      memcpy (cache[i].data, data, DISK_SECTOR_SIZE);
+  if (file_write_at (free_map_file, data, DISK_SECTOR_SIZE, ofs)
+      != DISK_SECTOR_SIZE)
     PANIC ("can't write free map");
 }
+
+/* Returns the number of free sectors in GROUP. */
+static size_t
+group_free (size_t group)
+{
+  const uint16_t *summary = get_block (summary_block (group));
+  return summary[group % SUMMARY_GROUPS];
+}
+
+/* Finds the first run of CNT free sectors and stores its first
+   sector into *STARTP.  Returns true if successful, false if
+   there is no such run. */
+static bool
+find_run (size_t cnt, disk_sector_t *startp)
+{
+  disk_sector_t run_start = 0;
+  size_t run_len = 0;
+  size_t group;
+
+  if (cnt == 0)
+    {
+      *startp = 0;
+      return true;
+    }
+
+  for (group = first_free_group; group < group_cnt; group++)
+    {
+      size_t avail = group_free (group);
+
+      if (avail == 0)
+        {
+          /* Full group: no run can cross it. */
+          if (run_len == 0 && group == first_free_group)
+            first_free_group++;
+          run_len = 0;
+        }
+      else if (avail == GROUP_SECTORS)
+        {
+          /* Free group: the run continues across it. */
+          if (run_len == 0)
+            run_start = group * GROUP_SECTORS;
+          run_len += GROUP_SECTORS;
+        }
+      else
+        {
+          const uint8_t *bits = get_block (bitmap_block (group));
+          size_t i;
+
+          for (i = 0; i < GROUP_SECTORS && run_len < cnt; i++)
+            if (bit_test (bits, i))
+              run_len = 0;
+            else if (run_len++ == 0)
+              run_start = group * GROUP_SECTORS + i;
+        }
+
+      if (run_len >= cnt)
+        {
+          *startp = run_start;
+          return true;
+        }
+    }
+  return false;
+}
+
+/* Lists the CNT sectors starting at SECTOR, which are about to
+   be allocated, as reserved in the header.  If MERGE is true and
+   they follow a reservation, extends that one instead.  Returns
+   false if the header has no room for another reservation. */
+static bool
+add_reservation (disk_sector_t sector, size_t cnt, bool merge)
+{
+  struct free_map_header *h = get_block (0);
+  size_t i = h->reserved_cnt;
+
+  if (merge)
+    for (i = 0; i < h->reserved_cnt; i++)
+      if (h->reserved[i].start + h->reserved[i].cnt == sector)
+        break;
+  if (i < h->reserved_cnt)
+    h->reserved[i].cnt += cnt;
+  else if (h->reserved_cnt < RESERVED_MAX)
+    {
+      h->reserved[i].start = sector;
+      h->reserved[i].cnt = cnt;
+      h->reserved_cnt++;
+    }
+  else
+    return false;
+  put_block (0, h);
+  return true;
+}
+
+/* Releases those of the CNT sectors starting at SECTOR that are
+   in use.  A reservation is listed before it is allocated and
+   after it is released, so after a crash it may be allocated
+   only in part. */
+static void
+release_used (disk_sector_t sector, size_t cnt)
+{
+  while (cnt > 0)
+    {
+      bool used = !range_free (sector, 1);
+      size_t n = 1;
+
+      while (n < cnt && range_free (sector + n, 1) != used)
+        n++;
+      if (used)
+        set_range (sector, n, false);
+      sector += n;
+      cnt -= n;
+    }
+}
+
+/* Returns true if all CNT sectors starting at SECTOR are free. */
+static bool
+range_free (disk_sector_t sector, size_t cnt)
+{
+  while (cnt > 0)
+    {
+      size_t group = sector / GROUP_SECTORS;
+      size_t ofs = sector % GROUP_SECTORS;
+      size_t n = GROUP_SECTORS - ofs < cnt ? GROUP_SECTORS - ofs : cnt;
+      size_t avail = group_free (group);
+
+      if (avail < n)
+        return false;
+      else if (avail < GROUP_SECTORS)
+        {
+          const uint8_t *bits = get_block (bitmap_block (group));
+          size_t i;
+
+          for (i = ofs; i < ofs + n; i++)
+            if (bit_test (bits, i))
+              return false;
+        }
+      sector += n;
+      cnt -= n;
+    }
+  return true;
+}
+
+/* Marks the CNT sectors starting at SECTOR as USED, or as free if
+   USED is false, updates the free sector count, and writes the
+   changes to the free map file.  Each sector must be in the
+   opposite state beforehand.
+
+   A range that spans many groups changes too many sectors of the
+   file for one journal transaction.  It is therefore handled in
+   pieces of at most SET_RANGE_GROUPS groups that share a summary
+   sector, each of which updates its bitmaps, then the summary
+   sector and the header just once, so that the journal can
+   commit between pieces and still find the free map
+   consistent. */
+static void
+set_range (disk_sector_t sector, size_t cnt, bool used)
+{
+  while (cnt > 0)
+    {
+      size_t first = sector / GROUP_SECTORS;
+      size_t last = (sector + cnt - 1) / GROUP_SECTORS;
+      size_t changed[SET_RANGE_GROUPS];
+      size_t total = 0;
+      size_t group;
+      struct free_map_header *h;
+      uint16_t *summary;
+
+      /* Choose this piece's groups. */
+      if (last - first >= SET_RANGE_GROUPS)
+        last = first + SET_RANGE_GROUPS - 1;
+      if (summary_block (last) != summary_block (first))
+        last = (first / SUMMARY_GROUPS + 1) * SUMMARY_GROUPS - 1;
+      journal_reserve (last - first + 3);
+
+      /* Update bitmaps. */
+      for (group = first; group <= last; group++)
+        {
+          size_t ofs = sector % GROUP_SECTORS;
+          size_t n = GROUP_SECTORS - ofs < cnt ? GROUP_SECTORS - ofs : cnt;
+          uint8_t *bits = get_block (bitmap_block (group));
+          size_t i;
+
+          for (i = ofs; i < ofs + n; i++)
+            {
+              ASSERT (bit_test (bits, i) != used);
+              bit_set (bits, i, used);
+            }
+          put_block (bitmap_block (group), bits);
+
+          changed[group - first] = n;
+          total += n;
+          sector += n;
+          cnt -= n;
+        }
+
+      /* Update summary and header. */
+      summary = get_block (summary_block (first));
+      for (group = first; group <= last; group++)
+        if (used)
+          summary[group % SUMMARY_GROUPS] -= changed[group - first];
+        else
+          summary[group % SUMMARY_GROUPS] += changed[group - first];
+      put_block (summary_block (first), summary);
+
+      if (used)
+        free_cnt -= total;
+      else
+        free_cnt += total;
+      h = get_block (0);
+      h->free_cnt = free_cnt;
+      put_block (0, h);
+    }
+}
@@ -12,6 +12,11 @@ void free_map_open (void);
 void free_map_close (void);
 
 bool free_map_allocate (size_t, disk_sector_t *);
+bool free_map_allocate_at (disk_sector_t, size_t);
+bool free_map_reserve (size_t, disk_sector_t *);
+bool free_map_reserve_at (disk_sector_t, size_t);
+void free_map_unreserve (disk_sector_t, size_t);
 void free_map_release (disk_sector_t, size_t);
+size_t free_map_largest (disk_sector_t *, size_t *extent_cnt);
 
 #endif /* filesys/free-map.h */
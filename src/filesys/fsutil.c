@@ -1,5 +1,6 @@
 #include "filesys/fsutil.h"
 #include <debug.h>
+#include <round.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,24 +8,55 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "filesys/inode.h"
+#include "filesys/tmpfs.h"
 #include "devices/disk.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
 
-/* List files in the root directory. */
+/* List files in the root directory.  For compressed files, also
+   prints the number of sectors their data occupies compared to
+   its size, and then the same totals for all of them. */
 void
 fsutil_ls (char **argv UNUSED) 
 {
   struct dir *dir;
   char name[NAME_MAX + 1];
+  char tmp_name[sizeof TMPFS_PREFIX + NAME_MAX];
+  size_t tmp_pos = 0;
+  size_t total_stored = 0, total_logical = 0;
   
   printf ("Files in the root directory:\n");
   dir = dir_open_root ();
   if (dir == NULL)
     PANIC ("root dir open failed");
   while (dir_readdir (dir, name))
-    printf ("%s\n", name);
+    {
+      struct inode *inode;
+      size_t stored, logical;
+
+      if (dir_lookup (dir, name, &inode)
+          && inode_compression (inode, &stored, &logical))
+        {
+          printf ("%s (compressed: %zu of %zu sectors)\n",
+                  name, stored, logical);
+          total_stored += stored;
+          total_logical += logical;
+        }
+      else
+        printf ("%s\n", name);
+      inode_close (inode);
+    }
+  dir_close (dir);
+  if (total_logical > 0)
+    printf ("Compressed files: %zu of %zu sectors, ratio %zu.%02zu:1\n",
+            total_stored, total_logical,
+            total_logical / (total_stored ? total_stored : 1),
+            total_logical * 100 / (total_stored ? total_stored : 1) % 100);
+  while (tmpfs_readdir (&tmp_pos, tmp_name, sizeof tmp_name))
+    printf ("%s\n", tmp_name);
   printf ("End of listing.\n");
 }
 
@@ -67,8 +99,29 @@ fsutil_rm (char **argv)
     PANIC ("%s: delete failed\n", file_name);
 }
 
+/* Copies file ARGV[1] to new file ARGV[2], sharing its data. */
+void
+fsutil_clone (char **argv) 
+{
+  const char *src_name = argv[1];
+  const char *dst_name = argv[2];
+
+  printf ("Cloning '%s' to '%s'...\n", src_name, dst_name);
+  if (!filesys_clone (src_name, dst_name))
+    PANIC ("%s: clone to %s failed", src_name, dst_name);
+}
+
+/* Number of sectors moved at a time between the scratch disk and
+   the file system by `extract' and `append'. */
+#define BULK_SECTORS 128
+
 /* Extracts a ustar-format tar archive from the scratch disk, hdc
-   or hd1:0, into the Pintos file system. */
+   or hd1:0, into the Pintos file system.
+
+   Each file is created at its full size, so that its data sectors
+   are allocated as one run up front, and then its data is copied
+   BULK_SECTORS at a time, with a single multi-sector disk request
+   on each side. */
 void
 fsutil_extract (char **argv UNUSED) 
 {
@@ -79,7 +132,7 @@ fsutil_extract (char **argv UNUSED)
 
   /* Allocate buffers. */
   header = malloc (DISK_SECTOR_SIZE);
-  data = malloc (DISK_SECTOR_SIZE);
+  data = palloc_get_multiple (0, BULK_SECTORS * DISK_SECTOR_SIZE / PGSIZE);
   if (header == NULL || data == NULL)
     PANIC ("couldn't allocate buffers");
 
@@ -109,7 +162,11 @@ fsutil_extract (char **argv UNUSED)
           break;
         }
       else if (type == USTAR_DIRECTORY)
-        printf ("ignoring directory %s\n", file_name);
+        {
+          printf ("Making directory '%s'...\n", file_name);
+          if (!filesys_mkdir (file_name))
+            PANIC ("%s: mkdir failed", file_name);
+        }
       else if (type == USTAR_REGULAR)
         {
           struct file *dst;
@@ -126,10 +183,17 @@ fsutil_extract (char **argv UNUSED)
           /* Do copy. */
           while (size > 0)
             {
-              int chunk_size = (size > DISK_SECTOR_SIZE
-                                ? DISK_SECTOR_SIZE
-                                : size);
-              disk_read (src, sector++, data);
+              size_t sector_cnt = DIV_ROUND_UP (size, DISK_SECTOR_SIZE);
+              int chunk_size;
+
+              if (sector_cnt > BULK_SECTORS)
+                sector_cnt = BULK_SECTORS;
+              chunk_size = sector_cnt * DISK_SECTOR_SIZE;
+              if (chunk_size > size)
+                chunk_size = size;
+
+              disk_read_sectors (src, sector, sector_cnt, data);
+              sector += sector_cnt;
               if (file_write (dst, data, chunk_size) != chunk_size)
                 PANIC ("%s: write failed with %d bytes unwritten",
                        file_name, size);
@@ -146,16 +210,15 @@ fsutil_extract (char **argv UNUSED)
      because two blocks of zeros are the ustar end-of-archive
      marker. */
   printf ("Erasing ustar archive...\n");
-  memset (header, 0, DISK_SECTOR_SIZE);
-  disk_write (src, 0, header);
-  disk_write (src, 1, header);
+  memset (data, 0, 2 * DISK_SECTOR_SIZE);
+  disk_write_sectors (src, 0, 2, data);
 
-  free (data);
+  palloc_free_multiple (data, BULK_SECTORS * DISK_SECTOR_SIZE / PGSIZE);
   free (header);
 }
 
 /* Copies file FILE_NAME from the file system to the scratch
-   disk, in ustar format.
+   disk, in ustar format, BULK_SECTORS at a time.
 
    The first call to this function will write starting at the
    beginning of the scratch disk.  Later calls advance across the
@@ -176,7 +239,7 @@ fsutil_append (char **argv)
   printf ("Appending '%s' to ustar archive on scratch disk...\n", file_name);
 
   /* Allocate buffer. */
-  buffer = malloc (DISK_SECTOR_SIZE);
+  buffer = palloc_get_multiple (0, BULK_SECTORS * DISK_SECTOR_SIZE / PGSIZE);
   if (buffer == NULL)
     PANIC ("couldn't allocate buffer");
 
@@ -199,24 +262,158 @@ fsutil_append (char **argv)
   /* Do copy. */
   while (size > 0) 
     {
-      int chunk_size = size > DISK_SECTOR_SIZE ? DISK_SECTOR_SIZE : size;
-      if (sector >= disk_size (dst))
+      size_t sector_cnt = DIV_ROUND_UP (size, DISK_SECTOR_SIZE);
+      off_t chunk_size;
+
+      if (sector_cnt > BULK_SECTORS)
+        sector_cnt = BULK_SECTORS;
+      chunk_size = sector_cnt * DISK_SECTOR_SIZE;
+      if (chunk_size > size)
+        chunk_size = size;
+
+      if (sector_cnt > disk_size (dst) - sector)
         PANIC ("%s: out of space on scratch disk", file_name);
       if (file_read (src, buffer, chunk_size) != chunk_size)
         PANIC ("%s: read failed with %"PROTd" bytes unread", file_name, size);
-      memset (buffer + chunk_size, 0, DISK_SECTOR_SIZE - chunk_size);
-      disk_write (dst, sector++, buffer);
+      memset (buffer + chunk_size, 0,
+              sector_cnt * DISK_SECTOR_SIZE - chunk_size);
+      disk_write_sectors (dst, sector, sector_cnt, buffer);
+      sector += sector_cnt;
       size -= chunk_size;
     }
 
   /* Write ustar end-of-archive marker, which is two consecutive
      sectors full of zeros.  Don't advance our position past
      them, though, in case we have more files to append. */
-  memset (buffer, 0, DISK_SECTOR_SIZE);
-  disk_write (dst, sector, buffer);
-  disk_write (dst, sector, buffer + 1);
+  if (2 > disk_size (dst) - sector)
+    PANIC ("%s: out of space on scratch disk", file_name);
+  memset (buffer, 0, 2 * DISK_SECTOR_SIZE);
+  disk_write_sectors (dst, sector, 2, buffer);
 
   /* Finish up. */
   file_close (src);
-  free (buffer);
+  palloc_free_multiple (buffer, BULK_SECTORS * DISK_SECTOR_SIZE / PGSIZE);
+}
+
+/* Statistics about the layout of the files in the file
+   system. */
+struct layout
+  {
+    size_t file_cnt;            /* Files with data sectors. */
+    size_t seq_cnt;             /* Files that follow the previous. */
+    size_t stuck_cnt;           /* Files that could not be moved. */
+    size_t free_extent_cnt;     /* Runs of free sectors. */
+    size_t free_longest;        /* Longest run of free sectors. */
+  };
+
+static void defrag_pass (struct layout *, bool move);
+static void defrag_dir (struct dir *, struct layout *, bool move,
+                        disk_sector_t *next);
+
+/* Defragments the file system: moves the data of each file, in
+   directory order, descending into each subdirectory where its
+   entry appears, to just after the data of the file before it,
+   or failing that, to the start of the largest run of free
+   sectors.  Afterward, files read in that order follow one
+   another on disk, and free space is gathered into fewer,
+   longer runs.
+
+   Each file's data is always one run of sectors, so a file is
+   never fragmented by itself.  Instead, this reports fragments of
+   free space, counts the files that can be read without a seek
+   after reading the file before them, and counts the files that
+   could be moved nowhere, such as clones, whose data is shared.
+   Directories hold metadata, which stays where it is. */
+void
+fsutil_defrag (char **argv UNUSED) 
+{
+  struct layout before, moved, after;
+
+  printf ("Defragmenting file system...\n");
+  defrag_pass (&before, false);
+  defrag_pass (&moved, true);
+  defrag_pass (&after, false);
+
+  printf ("Before: %zu free extents (longest %zu sectors), "
+          "%zu of %zu files seek-free.\n",
+          before.free_extent_cnt, before.free_longest,
+          before.seq_cnt, before.file_cnt);
+  printf ("After: %zu free extents (longest %zu sectors), "
+          "%zu of %zu files seek-free.\n",
+          after.free_extent_cnt, after.free_longest,
+          after.seq_cnt, after.file_cnt);
+  if (moved.stuck_cnt > 0)
+    printf ("%zu files could not be moved.\n", moved.stuck_cnt);
+}
+
+/* Walks the files in the file system in order and fills in *L
+   with statistics on their layout.  If MOVE is true, first tries
+   to move each file's data so that it follows the previous
+   file's data. */
+static void
+defrag_pass (struct layout *l, bool move) 
+{
+  struct dir *dir;
+  disk_sector_t next = 0;
+  disk_sector_t free_start;
+
+  dir = dir_open_root ();
+  if (dir == NULL)
+    PANIC ("root dir open failed");
+
+  l->file_cnt = l->seq_cnt = l->stuck_cnt = 0;
+  defrag_dir (dir, l, move, &next);
+  dir_close (dir);
+
+  l->free_longest = free_map_largest (&free_start, &l->free_extent_cnt);
+}
+
+/* Does the work of defrag_pass() for the files in DIR and its
+   subdirectories.  *NEXT is the sector just past the data of the
+   previous file, and is updated to follow the last file in
+   DIR. */
+static void
+defrag_dir (struct dir *dir, struct layout *l, bool move,
+            disk_sector_t *next) 
+{
+  char name[NAME_MAX + 1];
+  disk_sector_t free_start;
+
+  while (dir_readdir (dir, name))
+    {
+      struct inode *inode;
+      disk_sector_t start;
+      size_t cnt;
+
+      if (!dir_lookup (dir, name, &inode))
+        continue;
+      if (inode_is_dir (inode))
+        {
+          struct dir *subdir = dir_open (inode);
+          if (subdir != NULL)
+            {
+              defrag_dir (subdir, l, move, next);
+              dir_close (subdir);
+            }
+          continue;
+        }
+
+      cnt = inode_extent (inode, &start);
+      if (cnt > 0 && move && start != *next)
+        {
+          if (!inode_move (inode, *next)
+              && !(free_map_largest (&free_start, NULL) >= cnt
+                   && inode_move (inode, free_start)))
+            l->stuck_cnt++;
+          inode_extent (inode, &start);
+        }
+      if (cnt > 0)
+        {
+          l->file_cnt++;
+          if (start == *next)
+            l->seq_cnt++;
+          *next = start + cnt;
+        }
+      inode_close (inode);
+    }
 }
@@ -1,15 +1,34 @@
 #include "filesys/inode.h"
 #include <list.h>
 #include <debug.h>
+#include <lz.h>
 #include <round.h>
+#include <stdio.h>
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
+#include "filesys/tmpfs.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Identifies a shared-extent record. */
+#define REFS_MAGIC 0x52454653
+
+/* On-disk flag: the file's data is kept in the inode sector
+   itself, in inline_data[], rather than in START.  Set for files
+   no longer than INLINE_MAX bytes, so that opening and reading a
+   small file takes a single disk read.  Cleared for good once
+   the file grows past INLINE_MAX. */
+#define INODE_INLINE 0x80000000u
+
+/* Maximum length of a file whose data is inline. */
+#define INLINE_MAX (DISK_SECTOR_SIZE - 20)
+
 /* On-disk inode.
    Must be exactly DISK_SECTOR_SIZE bytes long. */
 struct inode_disk
@@ -17,9 +36,113 @@ struct inode_disk
     disk_sector_t start;                /* First data sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    unsigned flags;                     /* INODE_* flags. */
+    disk_sector_t refs;                 /* Shared-extent record, or 0. */
+    uint8_t inline_data[INLINE_MAX];    /* Data, if INODE_INLINE, or
+                                           chunk table, if
+                                           INODE_COMPRESSED. */
+  };
+
+/* Clones.
+
+   inode_clone() copies a file by making a new inode that shares
+   the original's run of data sectors, so that copying takes the
+   same time regardless of the file's size.  Inodes that share a
+   run point to a shared-extent record, a sector of its own that
+   counts them.  Before an inode that shares its run is written,
+   it gets a private copy of the run, and the count drops; when
+   the last sharer is removed, the run is freed along with the
+   record.  Since a file's data is always a single run, the whole
+   run is copied at once. */
+
+/* Shared-extent record.
+   Must be exactly DISK_SECTOR_SIZE bytes long. */
+struct extent_refs
+  {
+    disk_sector_t start;                /* First sector of the run. */
+    unsigned ref_cnt;                   /* Number of inodes sharing it. */
+    unsigned magic;                     /* Magic number. */
+    uint8_t unused[DISK_SECTOR_SIZE - 12];      /* Not used. */
   };
 
+/* Compression.
+
+   A file created with INODE_COMPRESSED has its data divided into
+   CHUNK_SIZE-byte chunks, each of which is compressed separately.
+   Its run of data sectors has a slot of CHUNK_SECTORS sectors
+   for each chunk, and its inline_data[] is reused as a table
+   giving the number of sectors of the slot each chunk actually
+   occupies: 0 for a chunk of zeros that was never written,
+   CHUNK_SECTORS for a chunk that did not compress and is stored
+   as is, and anything in between for compressed data.  Reading a
+   chunk therefore reads only the sectors it occupies, and since
+   each chunk has a slot of its own, rewriting one never disturbs
+   its neighbors.
+
+   The data of a chunk is not journaled, only its entry in the
+   table, so a rewrite must not destroy the old data before the
+   new entry commits.  When the old and new data fit in the slot
+   together, the new data goes in the part of the slot the old
+   data leaves free, at its start or its end as recorded by
+   CHUNK_AT_END, and the new entry is committed before the chunk
+   can be rewritten again.  Otherwise the entry is first marked
+   CHUNK_BAD and committed, so that after a crash in the middle
+   of the rewrite the chunk reads as an error rather than as
+   garbage.
+
+   One decompressed chunk per open inode is cached in memory.
+   Writes modify the cached chunk, which is compressed and written
+   back when another chunk is needed or the inode is closed. */
+
+/* Size of a chunk of a compressed file. */
+#define CHUNK_SIZE PGSIZE
+#define CHUNK_SECTORS (CHUNK_SIZE / DISK_SECTOR_SIZE)
+
+/* Maximum number of chunks in a compressed file. */
+#define CHUNK_MAX INLINE_MAX
+
+/* Bits of a chunk table entry other than its sector count. */
+#define CHUNK_AT_END 0x10       /* Data is at the end of the slot. */
+#define CHUNK_BAD 0xff          /* Data is being rewritten in place. */
+
+/* Delayed allocation.
+
+   When a write extends a regular file, the new data is not given
+   disk sectors right away.  Instead, it is kept in memory pages
+   hanging off the in-memory inode.  When the inode is closed or
+   the pages fill up, the whole delayed range is written back at
+   once: the file's run of sectors is extended (or moved) just
+   once to cover it, and the data goes out in multi-sector
+   requests.  A file written by many small appends thus ends up
+   in one contiguous run, without repeated relocation.
+
+   Write-back cannot be allowed to fail, since the write() that
+   produced the data has already returned.  So the sectors it
+   will need are allocated up front, as a reservation: either
+   those following the file's run, or a whole new run large enough
+   for the file.  Write-back releases the reservation and at once
+   extends the run, which must then succeed.  If no reservation
+   can be made, the write extends the file the ordinary way, and
+   fails right there if the disk is full.  The free map lists
+   reservations, so one that a crash leaves behind is reclaimed
+   at the next mount.
+
+   Write-back can still fail for lack of memory.  The data then
+   stays delayed, under its reservation, until a later write-back
+   succeeds.  An inode closed in that state stays in the list of
+   open inodes, where inode_open() and inode_flush_all() find it.
+
+   Delayed data covers the bytes from DELAYED_START, which is
+   sector-aligned, to the end of the file.  The part of the
+   on-disk data past DELAYED_START, if any, is copied in when
+   delaying starts. */
+
+/* Maximum amount of delayed data per inode, in pages. */
+#define DELAYED_PAGES 16
+
+/* Sectors per page. */
+#define SECTORS_PER_PAGE (PGSIZE / DISK_SECTOR_SIZE)
+
 /* Returns the number of sectors to allocate for an inode SIZE
    bytes long. */
 static inline size_t
@@ -28,6 +151,19 @@ bytes_to_sectors (off_t size)
   return DIV_ROUND_UP (size, DISK_SECTOR_SIZE);
 }
 
+/* Returns the number of data sectors in the run belonging to an
+   inode with the given FLAGS that is LENGTH bytes long. */
+static size_t
+data_sectors (unsigned flags, off_t length)
+{
+  if (flags & INODE_INLINE)
+    return 0;
+  else if (flags & INODE_COMPRESSED)
+    return DIV_ROUND_UP (length, CHUNK_SIZE) * CHUNK_SECTORS;
+  else
+    return bytes_to_sectors (length);
+}
+
 /* In-memory inode. */
 struct inode 
   {
@@ -36,7 +172,22 @@ struct inode
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
-    struct inode_disk data;             /* Inode content. */
+    struct tmpfs_node *tmp;             /* Tmpfs node, or null if on disk. */
+    struct inode_disk data;             /* Inode content (if on disk). */
+
+    /* Delayed allocation. */
+    off_t length;                       /* Length, with delayed data. */
+    bool delayed;                       /* Any delayed data? */
+    off_t delayed_start;                /* Offset of delayed data. */
+    uint8_t *delayed_pages[DELAYED_PAGES];      /* Delayed data. */
+    disk_sector_t reserved_start;       /* Sectors allocated for it... */
+    size_t reserved;                    /* ...and how many. */
+    bool reserved_in_place;             /* Reservation follows run? */
+
+    /* Compression. */
+    uint8_t *chunk;                     /* Cached chunk, decompressed. */
+    size_t chunk_idx;                   /* Index of cached chunk. */
+    bool chunk_dirty;                   /* Cached chunk modified? */
   };
 
 /* Returns the disk sector that contains byte offset POS within
@@ -53,10 +204,73 @@ byte_to_sector (const struct inode *inode, off_t pos)
     return -1;
 }
 
+/* Returns the number of whole sectors, starting at OFFSET, which
+   must be sector-aligned, that lie within the next SIZE bytes of
+   INODE and can be transferred directly between the disk and the
+   caller's buffer in a single multi-sector request.  Metadata,
+   which goes through the journal sector by sector, and delayed
+   data, which is in memory, never qualify. */
+static size_t
+run_sectors (const struct inode *inode, off_t offset, off_t size) 
+{
+  off_t end = inode->data.length;
+
+  ASSERT (offset % DISK_SECTOR_SIZE == 0);
+  if (inode->data.flags & (INODE_META | INODE_COMPRESSED))
+    return 0;
+  if (inode->delayed && inode->delayed_start < end)
+    end = inode->delayed_start;
+  if (size > end - offset)
+    size = end - offset;
+  return size > 0 ? size / DISK_SECTOR_SIZE : 0;
+}
+
+/* Reads data sector SECTOR of INODE into BUFFER.  Metadata is
+   read through the journal, which may hold newer contents than
+   the disk. */
+static void
+read_sector (const struct inode *inode, disk_sector_t sector, void *buffer)
+{
+  if (inode->data.flags & INODE_META)
+    journal_read (sector, buffer);
+  else
+    disk_read (filesys_disk, sector, buffer);
+}
+
+/* Writes BUFFER to data sector SECTOR of INODE.  Metadata is
+   written through the journal. */
+static void
+write_sector (const struct inode *inode, disk_sector_t sector,
+              const void *buffer)
+{
+  if (inode->data.flags & INODE_META)
+    journal_write (sector, buffer);
+  else
+    disk_write (filesys_disk, sector, buffer);
+}
+
 /* List of open inodes, so that opening a single inode twice
    returns the same `struct inode'. */
 static struct list open_inodes;
 
+static bool extend (struct inode *, off_t length, bool fill);
+static bool delay_extend (struct inode *, off_t length);
+static bool flush_delayed (struct inode *);
+static void discard_delayed (struct inode *);
+static bool reserve_sectors (struct inode *, size_t cnt);
+static void release_reserved (struct inode *);
+static off_t compressed_read_at (struct inode *, uint8_t *, off_t size,
+                                 off_t offset);
+static off_t compressed_write_at (struct inode *, const uint8_t *,
+                                  off_t size, off_t offset);
+static void flush_chunk (struct inode *);
+static size_t chunk_sectors (uint8_t entry);
+static bool move_run (struct inode *, disk_sector_t start);
+static bool unshare (struct inode *);
+static bool update_refs (disk_sector_t, int delta, unsigned *ref_cnt);
+static void copy_sectors (disk_sector_t from, disk_sector_t to, size_t cnt,
+                          uint8_t *buffer);
+
 /* Initializes the inode module. */
 void
 inode_init (void) 
@@ -64,13 +278,13 @@ inode_init (void)
   list_init (&open_inodes);
 }
 
-/* Initializes an inode with LENGTH bytes of data and
-   writes the new inode to sector SECTOR on the file system
-   disk.
+/* Initializes an inode with LENGTH bytes of data and the given
+   FLAGS and writes the new inode to sector SECTOR on the file
+   system disk.
    Returns true if successful.
    Returns false if memory or disk allocation fails. */
 bool
-inode_create (disk_sector_t sector, off_t length)
+inode_create (disk_sector_t sector, off_t length, unsigned flags)
 {
   struct inode_disk *disk_inode = NULL;
   bool success = false;
@@ -81,22 +295,43 @@ inode_create (disk_sector_t sector, off_t length)
      one sector in size, and you should fix that. */
   ASSERT (sizeof *disk_inode == DISK_SECTOR_SIZE);
 
+  if ((flags & INODE_COMPRESSED)
+      && DIV_ROUND_UP (length, CHUNK_SIZE) > CHUNK_MAX)
+    return false;
+
   disk_inode = calloc (1, sizeof *disk_inode);
-  if (disk_inode != NULL)
+  if (disk_inode != NULL && length <= INLINE_MAX
+      && !(flags & INODE_COMPRESSED))
     {
-      size_t sectors = bytes_to_sectors (length);
+      /* Inline data starts out as zeros, like any new file. */
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
+      disk_inode->flags = flags | INODE_INLINE;
+      journal_write (sector, disk_inode);
+      success = true;
+      free (disk_inode);
+    }
+  else if (disk_inode != NULL)
+    {
+      size_t sectors = data_sectors (flags, length);
+      disk_inode->length = length;
+      disk_inode->magic = INODE_MAGIC;
+      disk_inode->flags = flags;
       if (free_map_allocate (sectors, &disk_inode->start))
         {
-          disk_write (filesys_disk, sector, disk_inode);
-          if (sectors > 0) 
+          /* Compressed chunks start out empty, meaning zeros, so
+             their slots need not be cleared. */
+          journal_write (sector, disk_inode);
+          if (sectors > 0 && !(flags & INODE_COMPRESSED)) 
             {
               static char zeros[DISK_SECTOR_SIZE];
               size_t i;
               
               for (i = 0; i < sectors; i++) 
-                disk_write (filesys_disk, disk_inode->start + i, zeros); 
+                if (flags & INODE_META)
+                  journal_write (disk_inode->start + i, zeros);
+                else
+                  disk_write (filesys_disk, disk_inode->start + i, zeros); 
             }
           success = true; 
         } 
@@ -119,7 +354,7 @@ inode_open (disk_sector_t sector)
        e = list_next (e)) 
     {
       inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
+      if (inode->sector == sector && inode->tmp == NULL) 
         {
           inode_reopen (inode);
           return inode; 
@@ -137,7 +372,52 @@ inode_open (disk_sector_t sector)
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  disk_read (filesys_disk, inode->sector, &inode->data);
+  inode->tmp = NULL;
+  inode->delayed = false;
+  inode->reserved = 0;
+  inode->chunk = NULL;
+  inode->chunk_dirty = false;
+  journal_read (inode->sector, &inode->data);
+  inode->length = inode->data.length;
+  return inode;
+}
+
+/* Returns a `struct inode' for tmpfs node NODE.
+   Returns a null pointer if memory allocation fails. */
+struct inode *
+inode_open_tmpfs (struct tmpfs_node *node) 
+{
+  struct list_elem *e;
+  struct inode *inode;
+
+  /* Check whether this node is already open. */
+  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+       e = list_next (e)) 
+    {
+      inode = list_entry (e, struct inode, elem);
+      if (inode->tmp == node) 
+        {
+          inode_reopen (inode);
+          return inode; 
+        }
+    }
+
+  /* Allocate memory. */
+  inode = malloc (sizeof *inode);
+  if (inode == NULL)
+    return NULL;
+
+  /* Initialize. */
+  list_push_front (&open_inodes, &inode->elem);
+  inode->sector = tmpfs_inumber (node);
+  inode->open_cnt = 1;
+  inode->deny_write_cnt = 0;
+  inode->removed = false;
+  inode->tmp = node;
+  inode->delayed = false;
+  inode->reserved = 0;
+  inode->chunk = NULL;
+  inode->chunk_dirty = false;
   return inode;
 }
 
@@ -157,8 +437,31 @@ inode_get_inumber (const struct inode *inode)
   return inode->sector;
 }
 
-/* Closes INODE and writes it to disk.
-   If this was the last reference to INODE, frees its memory.
+/* Returns true if INODE is a directory. */
+bool
+inode_is_dir (const struct inode *inode)
+{
+  return inode->tmp == NULL && (inode->data.flags & INODE_DIR) != 0;
+}
+
+/* Returns true if INODE has been removed. */
+bool
+inode_is_removed (const struct inode *inode)
+{
+  return inode->removed;
+}
+
+/* Returns the number of openers of INODE. */
+int
+inode_open_cnt (const struct inode *inode)
+{
+  return inode->open_cnt;
+}
+
+/* Closes INODE and writes it to disk, including any delayed
+   data.
+   If this was the last reference to INODE, frees its memory,
+   unless delayed data could not be written back.
    If INODE was also a removed inode, frees its blocks. */
 void
 inode_close (struct inode *inode) 
@@ -170,15 +473,47 @@ inode_close (struct inode *inode)
   /* Release resources if this was the last opener. */
   if (--inode->open_cnt == 0)
     {
+      /* Write back or drop delayed data and the cached chunk.
+         Keep the inode if its delayed data cannot be written
+         back yet. */
+      if (inode->removed)
+        discard_delayed (inode);
+      else if (!flush_delayed (inode))
+        return;
+      else
+        flush_chunk (inode);
+
       /* Remove from inode list and release lock. */
       list_remove (&inode->elem);
  
+      if (inode->chunk != NULL)
+        palloc_free_page (inode->chunk);
+
       /* Deallocate blocks if removed. */
-      if (inode->removed) 
+      if (inode->removed && inode->tmp != NULL)
+        tmpfs_release (inode->tmp);
+      else if (inode->removed) 
         {
+          struct inode_disk *d = &inode->data;
+          bool last = true;
+
+          journal_begin ();
           free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
+
+          /* Data shared with clones goes with the last of them.  If
+             the count cannot be updated, the data must be assumed
+             to be still shared, so it is leaked rather than freed
+             under the clones' feet. */
+          if (d->refs != 0)
+            {
+              unsigned ref_cnt;
+              last = update_refs (d->refs, -1, &ref_cnt) && ref_cnt == 0;
+              if (last)
+                free_map_release (d->refs, 1);
+            }
+          if (last && !(d->flags & INODE_INLINE))
+            free_map_release (d->start, data_sectors (d->flags, d->length)); 
+          journal_end ();
         }
 
       free (inode); 
@@ -204,6 +539,22 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
   off_t bytes_read = 0;
   uint8_t *bounce = NULL;
 
+  if (inode->tmp != NULL)
+    return tmpfs_read_at (inode->tmp, buffer_, size, offset);
+  if (inode->data.flags & INODE_COMPRESSED)
+    return compressed_read_at (inode, buffer, size, offset);
+
+  if ((inode->data.flags & INODE_INLINE) && !inode->delayed)
+    {
+      /* Data is already in memory. */
+      if (offset >= inode->data.length)
+        return 0;
+      if (size > inode->data.length - offset)
+        size = inode->data.length - offset;
+      memcpy (buffer, inode->data.inline_data + offset, size);
+      return size;
+    }
+
   while (size > 0) 
     {
       /* Disk sector to read, starting byte offset within sector. */
@@ -216,14 +567,32 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       int min_left = inode_left < sector_left ? inode_left : sector_left;
 
       /* Number of bytes to actually copy out of this sector. */
-      int chunk_size = size < min_left ? size : min_left;
+      off_t chunk_size = size < min_left ? size : min_left;
+      size_t run_cnt;
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) 
+      if (sector_ofs == 0
+          && (run_cnt = run_sectors (inode, offset, size)) > 1) 
+        {
+          /* Read a run of full sectors directly into caller's
+             buffer. */
+          chunk_size = run_cnt * DISK_SECTOR_SIZE;
+          disk_read_sectors (filesys_disk, sector_idx, run_cnt,
+                             buffer + bytes_read);
+        }
+      else if (inode->delayed && offset >= inode->delayed_start) 
+        {
+          /* Copy out of delayed data. */
+          off_t ofs = offset - inode->delayed_start;
+          memcpy (buffer + bytes_read,
+                  inode->delayed_pages[ofs / PGSIZE] + ofs % PGSIZE,
+                  chunk_size);
+        }
+      else if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) 
         {
           /* Read full sector directly into caller's buffer. */
-          disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
+          read_sector (inode, sector_idx, buffer + bytes_read); 
         }
       else 
         {
@@ -235,7 +604,7 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
               if (bounce == NULL)
                 break;
             }
-          disk_read (filesys_disk, sector_idx, bounce);
+          read_sector (inode, sector_idx, bounce);
           memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
         }
       
@@ -251,9 +620,9 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if an error occurs.  A write past end of file
+   extends the inode; if that fails, the write stops at the old
+   end of file. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset) 
@@ -264,6 +633,36 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 
   if (inode->deny_write_cnt)
     return 0;
+  if (inode->tmp != NULL)
+    return tmpfs_write_at (inode->tmp, buffer_, size, offset);
+  if (!unshare (inode))
+    return 0;
+
+  if (size > 0 && offset + size > inode_length (inode)
+      && !delay_extend (inode, offset + size))
+    {
+      /* Delayed data must reach the disk before the file can be
+         extended the ordinary way. */
+      if (flush_delayed (inode))
+        extend (inode, offset + size, true);
+    }
+
+  if (inode->data.flags & INODE_COMPRESSED)
+    return compressed_write_at (inode, buffer, size, offset);
+
+  if ((inode->data.flags & INODE_INLINE) && !inode->delayed)
+    {
+      /* Update inline data, then write back the inode. */
+      if (offset >= inode->data.length)
+        return 0;
+      if (size > inode->data.length - offset)
+        size = inode->data.length - offset;
+      journal_begin ();
+      memcpy (inode->data.inline_data + offset, buffer, size);
+      journal_write (inode->sector, &inode->data);
+      journal_end ();
+      return size;
+    }
 
   while (size > 0) 
     {
@@ -277,14 +676,30 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       int min_left = inode_left < sector_left ? inode_left : sector_left;
 
       /* Number of bytes to actually write into this sector. */
-      int chunk_size = size < min_left ? size : min_left;
+      off_t chunk_size = size < min_left ? size : min_left;
+      size_t run_cnt;
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) 
+      if (sector_ofs == 0
+          && (run_cnt = run_sectors (inode, offset, size)) > 1) 
+        {
+          /* Write a run of full sectors directly to disk. */
+          chunk_size = run_cnt * DISK_SECTOR_SIZE;
+          disk_write_sectors (filesys_disk, sector_idx, run_cnt,
+                              buffer + bytes_written);
+        }
+      else if (inode->delayed && offset >= inode->delayed_start) 
+        {
+          /* Copy into delayed data. */
+          off_t ofs = offset - inode->delayed_start;
+          memcpy (inode->delayed_pages[ofs / PGSIZE] + ofs % PGSIZE,
+                  buffer + bytes_written, chunk_size);
+        }
+      else if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) 
         {
           /* Write full sector directly to disk. */
-          disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
+          write_sector (inode, sector_idx, buffer + bytes_written); 
         }
       else 
         {
@@ -300,11 +715,11 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
              we're writing, then we need to read in the sector
              first.  Otherwise we start with a sector of all zeros. */
           if (sector_ofs > 0 || chunk_size < sector_left) 
-            disk_read (filesys_disk, sector_idx, bounce);
+            read_sector (inode, sector_idx, bounce);
           else
             memset (bounce, 0, DISK_SECTOR_SIZE);
           memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          disk_write (filesys_disk, sector_idx, bounce); 
+          write_sector (inode, sector_idx, bounce); 
         }
 
       /* Advance. */
@@ -317,6 +732,806 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
   return bytes_written;
 }
 
+/* Writes zeros to the CNT newly allocated sectors starting at
+   SECTOR. */
+static void
+zero_sectors (disk_sector_t sector, size_t cnt)
+{
+  static char zeros[DISK_SECTOR_SIZE];
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    disk_write (filesys_disk, sector + i, zeros);
+}
+
+/* Extends INODE's on-disk data to LENGTH bytes.  If FILL is
+   true, fills the new space with zeros and copies inline data
+   into its first sector; otherwise, the caller will write the
+   new space itself.  The data stays in one contiguous run of
+   sectors: the run grows in place if the sectors following it
+   are free, and moves to a new run otherwise.  Inline data moves
+   into a run of sectors once LENGTH exceeds INLINE_MAX.  Returns
+   true if successful, false if memory or disk allocation
+   fails.
+
+   Newly allocated sectors are written straight to disk, even for
+   metadata: nothing refers to them until the inode is updated,
+   and by then the disk writes are done.  Journaling them instead
+   would make the transaction grow with the size of the file. */
+static bool
+extend (struct inode *inode, off_t length, bool fill)
+{
+  struct inode_disk *d = &inode->data;
+  size_t old_cnt, new_cnt;
+  disk_sector_t start;
+  uint8_t *bounce = NULL;
+  bool success = false;
+
+  ASSERT (length > d->length);
+
+  if ((d->flags & INODE_COMPRESSED)
+      && DIV_ROUND_UP (length, CHUNK_SIZE) > CHUNK_MAX)
+    return false;
+
+  journal_begin ();
+  new_cnt = data_sectors (d->flags & ~INODE_INLINE, length);
+  if (d->flags & INODE_INLINE)
+    {
+      if (length <= INLINE_MAX)
+        success = true;
+      else if ((bounce = calloc (1, DISK_SECTOR_SIZE)) != NULL
+               && free_map_allocate (new_cnt, &start))
+        {
+          /* Inline data becomes the first sector. */
+          if (fill)
+            {
+              memcpy (bounce, d->inline_data, d->length);
+              disk_write (filesys_disk, start, bounce);
+              zero_sectors (start + 1, new_cnt - 1);
+            }
+          memset (d->inline_data, 0, sizeof d->inline_data);
+          d->flags &= ~INODE_INLINE;
+          d->start = start;
+          success = true;
+        }
+    }
+  else
+    {
+      old_cnt = data_sectors (d->flags, d->length);
+      if (new_cnt == old_cnt)
+        success = true;
+      else if (old_cnt > 0
+               && free_map_allocate_at (d->start + old_cnt,
+                                        new_cnt - old_cnt))
+        {
+          if (fill && !(d->flags & INODE_COMPRESSED))
+            zero_sectors (d->start + old_cnt, new_cnt - old_cnt);
+          success = true;
+        }
+      else if ((bounce = malloc (DISK_SECTOR_SIZE)) != NULL
+               && free_map_allocate (new_cnt, &start))
+        {
+          size_t i;
+
+          for (i = 0; i < old_cnt; i++)
+            {
+              read_sector (inode, d->start + i, bounce);
+              disk_write (filesys_disk, start + i, bounce);
+            }
+          if (fill && !(d->flags & INODE_COMPRESSED))
+            zero_sectors (start + old_cnt, new_cnt - old_cnt);
+          if (old_cnt > 0)
+            journal_release_after_commit (d->start, old_cnt);
+          d->start = start;
+          success = true;
+        }
+    }
+
+  if (success)
+    {
+      d->length = length;
+      if (inode->length < length)
+        inode->length = length;
+      journal_write (inode->sector, d);
+    }
+  journal_end ();
+  free (bounce);
+  return success;
+}
+
+/* Tries to extend INODE to LENGTH bytes by adding delayed data
+   rather than allocating sectors.  Returns true if successful.
+   Returns false if INODE holds metadata, whose sectors must be
+   journaled, or if memory or free sectors run short; the caller
+   should then extend INODE the ordinary way. */
+static bool
+delay_extend (struct inode *inode, off_t length)
+{
+  struct inode_disk *d = &inode->data;
+  size_t i;
+
+  if (d->flags & (INODE_META | INODE_COMPRESSED))
+    return false;
+  if ((d->flags & INODE_INLINE) && length <= INLINE_MAX)
+    return false;
+
+  /* Make room by writing back what is already delayed. */
+  if (inode->delayed
+      && length - inode->delayed_start > DELAYED_PAGES * PGSIZE
+      && !flush_delayed (inode))
+    return false;
+
+  if (!inode->delayed)
+    {
+      off_t start = (d->flags & INODE_INLINE
+                     ? 0 : ROUND_DOWN (d->length, DISK_SECTOR_SIZE));
+      if (length - start > DELAYED_PAGES * PGSIZE)
+        return false;
+      inode->delayed_start = start;
+      for (i = 0; i < DELAYED_PAGES; i++)
+        inode->delayed_pages[i] = NULL;
+    }
+
+  /* Make sure write-back will find room for the whole file. */
+  if (!reserve_sectors (inode, bytes_to_sectors (length)))
+    goto fail;
+
+  /* Get pages to hold the data. */
+  for (i = 0; i < (size_t) DIV_ROUND_UP (length - inode->delayed_start,
+                                        PGSIZE); i++)
+    if (inode->delayed_pages[i] == NULL)
+      {
+        inode->delayed_pages[i] = palloc_get_page (PAL_ZERO);
+        if (inode->delayed_pages[i] == NULL)
+          goto fail;
+      }
+
+  /* Bring in the on-disk data that the delayed data overlaps. */
+  if (!inode->delayed)
+    {
+      if (d->flags & INODE_INLINE)
+        memcpy (inode->delayed_pages[0], d->inline_data, d->length);
+      else if (d->length > inode->delayed_start)
+        read_sector (inode, byte_to_sector (inode, inode->delayed_start),
+                     inode->delayed_pages[0]);
+      inode->delayed = true;
+    }
+  inode->length = length;
+  return true;
+
+ fail:
+  if (!inode->delayed)
+    discard_delayed (inode);
+  return false;
+}
+
+/* Makes sure that INODE's run of data sectors can be extended
+   to CNT sectors when its delayed data is written back, by
+   allocating the sectors that are missing: preferably those
+   following the run or the current reservation, otherwise a new
+   run of CNT sectors that replaces the reservation.  Returns true
+   if successful, false if no such sectors are free. */
+static bool
+reserve_sectors (struct inode *inode, size_t cnt)
+{
+  struct inode_disk *d = &inode->data;
+  size_t old_cnt = data_sectors (d->flags, d->length);
+  disk_sector_t end, start;
+  size_t have;
+  bool success = false;
+
+  /* Sectors covered so far, and the sector just past them. */
+  if (inode->reserved > 0 && !inode->reserved_in_place)
+    {
+      have = inode->reserved;
+      end = inode->reserved_start + inode->reserved;
+    }
+  else
+    {
+      have = old_cnt + inode->reserved;
+      end = d->start + have;
+    }
+  if (cnt <= have)
+    return true;
+
+  journal_begin ();
+  if (have > 0 && free_map_reserve_at (end, cnt - have))
+    {
+      if (inode->reserved == 0)
+        {
+          inode->reserved_start = end;
+          inode->reserved_in_place = true;
+        }
+      inode->reserved += cnt - have;
+      success = true;
+    }
+  else if (free_map_reserve (cnt, &start))
+    {
+      release_reserved (inode);
+      inode->reserved_start = start;
+      inode->reserved = cnt;
+      inode->reserved_in_place = false;
+      success = true;
+    }
+  journal_end ();
+  return success;
+}
+
+/* Releases the sectors reserved for INODE's delayed data, if
+   any.  Nothing refers to them, so they can go back to the free
+   map right away. */
+static void
+release_reserved (struct inode *inode)
+{
+  if (inode->reserved == 0)
+    return;
+  journal_begin ();
+  free_map_unreserve (inode->reserved_start, inode->reserved);
+  journal_end ();
+  inode->reserved = 0;
+}
+
+/* Writes back INODE's delayed data, if any: extends its run of
+   sectors once to cover all of it, then writes it out a page at
+   a time.  The reservation made by reserve_sectors() guarantees
+   that the disk has room.  Returns true if successful.  On
+   failure, which takes running out of memory, the data stays
+   delayed. */
+static bool
+flush_delayed (struct inode *inode)
+{
+  struct inode_disk *d = &inode->data;
+  off_t length = inode->length;
+  disk_sector_t reserved_start = inode->reserved_start;
+  size_t reserved = inode->reserved;
+  bool reserved_in_place = inode->reserved_in_place;
+  size_t sector_cnt, i;
+  bool success;
+
+  if (!inode->delayed)
+    return true;
+
+  journal_begin ();
+  release_reserved (inode);
+  success = extend (inode, length, false);
+  if (success)
+    {
+      disk_sector_t sector = d->start + inode->delayed_start / DISK_SECTOR_SIZE;
+
+      sector_cnt = bytes_to_sectors (length - inode->delayed_start);
+      for (i = 0; i * SECTORS_PER_PAGE < sector_cnt; i++)
+        {
+          size_t cnt = sector_cnt - i * SECTORS_PER_PAGE;
+          if (cnt > SECTORS_PER_PAGE)
+            cnt = SECTORS_PER_PAGE;
+          disk_write_sectors (filesys_disk, sector + i * SECTORS_PER_PAGE,
+                              cnt, inode->delayed_pages[i]);
+        }
+    }
+  else if (reserved > 0
+           && (reserved_in_place
+               ? free_map_reserve_at (reserved_start, reserved)
+               : free_map_reserve (reserved, &reserved_start)))
+    {
+      /* Take the reservation back, for the next attempt. */
+      inode->reserved_start = reserved_start;
+      inode->reserved = reserved;
+      inode->reserved_in_place = reserved_in_place;
+    }
+  journal_end ();
+
+  if (success)
+    discard_delayed (inode);
+  return success;
+}
+
+/* Frees INODE's delayed data without writing it back. */
+static void
+discard_delayed (struct inode *inode)
+{
+  size_t i;
+
+  for (i = 0; i < DELAYED_PAGES; i++)
+    if (inode->delayed_pages[i] != NULL)
+      {
+        palloc_free_page (inode->delayed_pages[i]);
+        inode->delayed_pages[i] = NULL;
+      }
+  release_reserved (inode);
+  inode->delayed = false;
+  inode->length = inode->data.length;
+}
+
+/* Returns the number of sectors in INODE's run of data sectors
+   and stores the first of them into *START.  Returns 0 if INODE
+   has no data sectors, because it is empty, inline, or in tmpfs,
+   or if its delayed data, which is written back first, cannot
+   be. */
+size_t
+inode_extent (struct inode *inode, disk_sector_t *start) 
+{
+  if (inode->tmp != NULL || !flush_delayed (inode))
+    return 0;
+  flush_chunk (inode);
+  if (inode->data.flags & INODE_INLINE)
+    return 0;
+  *start = inode->data.start;
+  return data_sectors (inode->data.flags, inode->data.length);
+}
+
+/* Moves INODE's data sectors to the run starting at sector START,
+   which must be large enough to hold them and free, except that
+   it may overlap INODE's current run.  Returns true if
+   successful, false if the run is not free or if INODE has no
+   data sectors or holds metadata, which stays where it is.
+
+   The current run cannot be overwritten until the move commits,
+   so a move to an overlapping run goes through the largest run
+   of free sectors elsewhere, committing in between.  If that
+   run is too small or overlaps START's run too, the move fails.
+   If the second step fails, the data stays where the first one
+   put it. */
+bool
+inode_move (struct inode *inode, disk_sector_t start) 
+{
+  struct inode_disk *d = &inode->data;
+  disk_sector_t old_start, stage;
+  size_t cnt;
+
+  cnt = inode_extent (inode, &old_start);
+  if (cnt == 0 || (d->flags & INODE_META) || d->refs != 0
+      || start == old_start)
+    return false;
+
+  if (start < old_start + cnt && old_start < start + cnt)
+    {
+      if (free_map_largest (&stage, NULL) < cnt
+          || (stage < start + cnt && start < stage + cnt)
+          || !move_run (inode, stage))
+        return false;
+
+      /* Commit, so that the old run may be reused. */
+      journal_begin ();
+      journal_commit ();
+      journal_end ();
+    }
+  return move_run (inode, start);
+}
+
+/* Moves INODE's run of data sectors to the free run starting at
+   sector START.  Returns true if successful, false if the run
+   is not free or memory allocation fails. */
+static bool
+move_run (struct inode *inode, disk_sector_t start) 
+{
+  struct inode_disk *d = &inode->data;
+  disk_sector_t old_start = d->start;
+  size_t cnt = data_sectors (d->flags, d->length);
+  uint8_t *buffer;
+
+  buffer = palloc_get_page (0);
+  if (buffer == NULL)
+    return false;
+
+  journal_begin ();
+  if (!free_map_allocate_at (start, cnt))
+    {
+      journal_end ();
+      palloc_free_page (buffer);
+      return false;
+    }
+
+  copy_sectors (old_start, start, cnt, buffer);
+  d->start = start;
+  journal_write (inode->sector, d);
+  journal_release_after_commit (old_start, cnt);
+  journal_end ();
+  palloc_free_page (buffer);
+  return true;
+}
+
+/* Creates at SECTOR a new inode that is a copy of SRC, sharing
+   SRC's data sectors rather than copying them.  Returns true if
+   successful, false if SRC is in tmpfs or holds metadata, or if
+   memory or disk allocation fails. */
+bool
+inode_clone (struct inode *src, disk_sector_t sector) 
+{
+  struct inode_disk *d = &src->data;
+  unsigned ref_cnt;
+  bool success = false;
+
+  if (src->tmp != NULL || (d->flags & INODE_META)
+      || !flush_delayed (src))
+    return false;
+  flush_chunk (src);
+
+  journal_begin ();
+  if (data_sectors (d->flags, d->length) == 0)
+    {
+      /* Nothing to share: the data, if any, is inline. */
+      success = true;
+    }
+  else if (d->refs != 0)
+    success = update_refs (d->refs, 1, &ref_cnt);
+  else
+    {
+      struct extent_refs *r = calloc (1, sizeof *r);
+      if (r != NULL && free_map_allocate (1, &d->refs))
+        {
+          r->start = d->start;
+          r->ref_cnt = 2;
+          r->magic = REFS_MAGIC;
+          journal_write (d->refs, r);
+          journal_write (src->sector, d);
+          success = true;
+        }
+      free (r);
+    }
+  if (success)
+    journal_write (sector, d);
+  journal_end ();
+  return success;
+}
+
+/* If INODE shares its data sectors with clones, gives it a
+   private copy of them so that it may be modified.  Returns true
+   if successful, false if memory or disk allocation fails. */
+static bool
+unshare (struct inode *inode) 
+{
+  struct inode_disk *d = &inode->data;
+  size_t cnt = data_sectors (d->flags, d->length);
+  disk_sector_t start;
+  unsigned ref_cnt;
+  uint8_t *buffer;
+  bool success = false;
+
+  if (d->refs == 0)
+    return true;
+  buffer = palloc_get_page (0);
+  if (buffer == NULL)
+    return false;
+
+  journal_begin ();
+  if (update_refs (d->refs, -1, &ref_cnt))
+    {
+      if (ref_cnt == 0)
+        {
+          /* The other sharers are gone, so the run is ours. */
+          free_map_release (d->refs, 1);
+          success = true;
+        }
+      else if (free_map_allocate (cnt, &start))
+        {
+          copy_sectors (d->start, start, cnt, buffer);
+          d->start = start;
+          success = true;
+        }
+      else
+        update_refs (d->refs, 1, &ref_cnt);
+    }
+  if (success)
+    {
+      d->refs = 0;
+      journal_write (inode->sector, d);
+    }
+  journal_end ();
+  palloc_free_page (buffer);
+  return success;
+}
+
+/* Adds DELTA to the count in the shared-extent record at SECTOR
+   and stores the new count into *REF_CNT.  Returns true if
+   successful, false if memory allocation fails. */
+static bool
+update_refs (disk_sector_t sector, int delta, unsigned *ref_cnt) 
+{
+  struct extent_refs *r = malloc (sizeof *r);
+  if (r == NULL)
+    return false;
+
+  ASSERT (sizeof *r == DISK_SECTOR_SIZE);
+  journal_read (sector, r);
+  if (r->magic != REFS_MAGIC)
+    PANIC ("sector %"PRDSNu": bad shared-extent record", sector);
+  r->ref_cnt += delta;
+  *ref_cnt = r->ref_cnt;
+  journal_write (sector, r);
+  free (r);
+  return true;
+}
+
+/* Copies the CNT data sectors starting at FROM to the run starting
+   at TO, a page at a time, using BUFFER, which must be a page. */
+static void
+copy_sectors (disk_sector_t from, disk_sector_t to, size_t cnt,
+              uint8_t *buffer) 
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i += SECTORS_PER_PAGE)
+    {
+      size_t chunk = cnt - i < SECTORS_PER_PAGE ? cnt - i : SECTORS_PER_PAGE;
+      disk_read_sectors (filesys_disk, from + i, chunk, buffer);
+      disk_write_sectors (filesys_disk, to + i, chunk, buffer);
+    }
+}
+
+/* Writes back the delayed data and cached chunk of every open
+   inode. */
+void
+inode_flush_all (void)
+{
+  struct list_elem *e;
+
+  e = list_begin (&open_inodes);
+  while (e != list_end (&open_inodes))
+    {
+      struct inode *inode = list_entry (e, struct inode, elem);
+      e = list_next (e);
+      if (flush_delayed (inode))
+        {
+          flush_chunk (inode);
+
+          /* Finish closing an inode kept only for its delayed
+             data. */
+          if (inode->open_cnt == 0)
+            {
+              inode->open_cnt = 1;
+              inode_close (inode);
+            }
+        }
+    }
+}
+
+/* If INODE is compressed, stores the number of sectors its data
+   occupies on disk into *STORED and the number it would occupy
+   uncompressed into *LOGICAL, and returns true.  Otherwise,
+   returns false. */
+bool
+inode_compression (struct inode *inode, size_t *stored, size_t *logical) 
+{
+  size_t i;
+
+  if (inode->tmp != NULL || !(inode->data.flags & INODE_COMPRESSED))
+    return false;
+  flush_chunk (inode);
+  *stored = 0;
+  for (i = 0; i < (size_t) DIV_ROUND_UP (inode->data.length, CHUNK_SIZE);
+       i++)
+    *stored += chunk_sectors (inode->data.inline_data[i]);
+  *logical = bytes_to_sectors (inode->data.length);
+  return true;
+}
+
+/* Returns the number of sectors occupied by a chunk whose table
+   entry is ENTRY. */
+static size_t
+chunk_sectors (uint8_t entry) 
+{
+  return entry != CHUNK_BAD ? entry & ~CHUNK_AT_END : 0;
+}
+
+/* Returns the first sector occupied by chunk CHUNK_IDX of
+   compressed INODE if its table entry were ENTRY. */
+static disk_sector_t
+chunk_start (const struct inode *inode, size_t chunk_idx, uint8_t entry) 
+{
+  disk_sector_t sector = inode->data.start + chunk_idx * CHUNK_SECTORS;
+  if (entry != CHUNK_BAD && (entry & CHUNK_AT_END))
+    sector += CHUNK_SECTORS - chunk_sectors (entry);
+  return sector;
+}
+
+/* Reads chunk CHUNK_IDX of compressed INODE from disk and
+   decompresses it into BUFFER, which must have room for
+   CHUNK_SIZE bytes.  Returns false if the chunk is corrupt or
+   memory allocation fails. */
+static bool
+read_chunk (struct inode *inode, size_t chunk_idx, uint8_t *buffer) 
+{
+  uint8_t entry = inode->data.inline_data[chunk_idx];
+  size_t cnt = chunk_sectors (entry);
+  disk_sector_t sector = chunk_start (inode, chunk_idx, entry);
+  uint8_t *packed;
+  bool success;
+
+  if (entry == CHUNK_BAD)
+    return false;
+  else if (cnt == 0)
+    memset (buffer, 0, CHUNK_SIZE);
+  else if (cnt == CHUNK_SECTORS)
+    disk_read_sectors (filesys_disk, sector, cnt, buffer);
+  else 
+    {
+      packed = palloc_get_page (0);
+      if (packed == NULL)
+        return false;
+      disk_read_sectors (filesys_disk, sector, cnt, packed);
+      success = lz_decompress (packed, cnt * DISK_SECTOR_SIZE,
+                               buffer, CHUNK_SIZE) == CHUNK_SIZE;
+      palloc_free_page (packed);
+      return success;
+    }
+  return true;
+}
+
+/* Compresses the CHUNK_SIZE bytes in BUFFER and writes them to
+   disk as chunk CHUNK_IDX of compressed INODE.  Stores the chunk
+   as is if it does not compress by at least a sector. */
+static void
+write_chunk (struct inode *inode, size_t chunk_idx, const uint8_t *buffer) 
+{
+  struct inode_disk *d = &inode->data;
+  uint8_t old_entry = d->inline_data[chunk_idx];
+  size_t old_cnt = chunk_sectors (old_entry);
+  size_t max_size = (CHUNK_SECTORS - 1) * DISK_SECTOR_SIZE;
+  size_t packed_size = 0;
+  const uint8_t *data;
+  uint8_t *packed;
+  uint8_t entry;
+  size_t cnt;
+
+  /* The first page holds the output, the second the compressor's
+     work area. */
+  packed = palloc_get_multiple (0, 2);
+  if (packed != NULL)
+    packed_size = lz_compress (buffer, CHUNK_SIZE, packed, max_size,
+                               packed + PGSIZE);
+
+  if (packed_size > 0) 
+    {
+      cnt = DIV_ROUND_UP (packed_size, DISK_SECTOR_SIZE);
+      memset (packed + packed_size, 0,
+              cnt * DISK_SECTOR_SIZE - packed_size);
+      data = packed;
+    }
+  else
+    {
+      cnt = CHUNK_SECTORS;
+      data = buffer;
+    }
+
+  journal_begin ();
+  if (old_cnt + cnt <= CHUNK_SECTORS)
+    {
+      /* Put the new data where the old data is not. */
+      entry = cnt;
+      if (old_cnt > 0 && !(old_entry & CHUNK_AT_END))
+        entry |= CHUNK_AT_END;
+    }
+  else
+    {
+      /* The new data must overwrite the old. */
+      d->inline_data[chunk_idx] = CHUNK_BAD;
+      journal_write (inode->sector, d);
+      journal_commit ();
+      entry = cnt;
+      old_cnt = 0;
+    }
+  disk_write_sectors (filesys_disk, chunk_start (inode, chunk_idx, entry),
+                      cnt, data);
+  d->inline_data[chunk_idx] = entry;
+  journal_write (inode->sector, d);
+
+  /* The next rewrite may overwrite the old data, so the disk must
+     stop referring to it first. */
+  if (old_cnt > 0)
+    journal_commit ();
+  journal_end ();
+
+  if (packed != NULL)
+    palloc_free_multiple (packed, 2);
+}
+
+/* Makes chunk CHUNK_IDX of compressed INODE its cached chunk,
+   writing back the chunk cached before if it was modified, and
+   returns it.  If READ is false, the caller is about to overwrite
+   the whole chunk, so it is not read from disk.  Returns a null
+   pointer if memory allocation fails or the chunk is corrupt. */
+static uint8_t *
+get_chunk (struct inode *inode, size_t chunk_idx, bool read) 
+{
+  if (inode->chunk != NULL && inode->chunk_idx == chunk_idx)
+    return inode->chunk;
+
+  if (inode->chunk == NULL) 
+    {
+      inode->chunk = palloc_get_page (0);
+      if (inode->chunk == NULL)
+        return NULL;
+    }
+  else
+    flush_chunk (inode);
+
+  if (read && !read_chunk (inode, chunk_idx, inode->chunk)) 
+    {
+      palloc_free_page (inode->chunk);
+      inode->chunk = NULL;
+      return NULL;
+    }
+  inode->chunk_idx = chunk_idx;
+  return inode->chunk;
+}
+
+/* Writes back INODE's cached chunk, if it has been modified. */
+static void
+flush_chunk (struct inode *inode) 
+{
+  if (inode->chunk != NULL && inode->chunk_dirty) 
+    {
+      write_chunk (inode, inode->chunk_idx, inode->chunk);
+      inode->chunk_dirty = false;
+    }
+}
+
+/* Reads SIZE bytes from compressed INODE into BUFFER, starting
+   at position OFFSET.  Returns the number of bytes actually
+   read. */
+static off_t
+compressed_read_at (struct inode *inode, uint8_t *buffer, off_t size,
+                    off_t offset) 
+{
+  off_t bytes_read = 0;
+
+  while (size > 0 && offset < inode->data.length) 
+    {
+      /* Bytes left in inode, bytes left in chunk, lesser of the two. */
+      int chunk_ofs = offset % CHUNK_SIZE;
+      off_t inode_left = inode->data.length - offset;
+      int chunk_left = CHUNK_SIZE - chunk_ofs;
+      int min_left = inode_left < chunk_left ? inode_left : chunk_left;
+
+      /* Number of bytes to actually copy out of this chunk. */
+      int chunk_size = size < min_left ? size : min_left;
+      uint8_t *chunk = get_chunk (inode, offset / CHUNK_SIZE, true);
+      if (chunk == NULL)
+        break;
+      memcpy (buffer + bytes_read, chunk + chunk_ofs, chunk_size);
+
+      /* Advance. */
+      size -= chunk_size;
+      offset += chunk_size;
+      bytes_read += chunk_size;
+    }
+  return bytes_read;
+}
+
+/* Writes SIZE bytes from BUFFER into compressed INODE, starting
+   at OFFSET, which must already be long enough.  Returns the
+   number of bytes actually written. */
+static off_t
+compressed_write_at (struct inode *inode, const uint8_t *buffer, off_t size,
+                     off_t offset) 
+{
+  off_t bytes_written = 0;
+
+  while (size > 0 && offset < inode->data.length) 
+    {
+      /* Bytes left in inode, bytes left in chunk, lesser of the two. */
+      int chunk_ofs = offset % CHUNK_SIZE;
+      off_t inode_left = inode->data.length - offset;
+      int chunk_left = CHUNK_SIZE - chunk_ofs;
+      int min_left = inode_left < chunk_left ? inode_left : chunk_left;
+
+      /* Number of bytes to actually write into this chunk. */
+      int chunk_size = size < min_left ? size : min_left;
+      uint8_t *chunk = get_chunk (inode, offset / CHUNK_SIZE,
+                                  chunk_size < CHUNK_SIZE);
+      if (chunk == NULL)
+        break;
+      memcpy (chunk + chunk_ofs, buffer + bytes_written, chunk_size);
+      inode->chunk_dirty = true;
+
+      /* Advance. */
+      size -= chunk_size;
+      offset += chunk_size;
+      bytes_written += chunk_size;
+    }
+  return bytes_written;
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
@@ -341,5 +1556,7 @@ inode_allow_write (struct inode *inode)
 off_t
 inode_length (const struct inode *inode)
 {
-  return inode->data.length;
+  if (inode->tmp != NULL)
+    return tmpfs_length (inode->tmp);
+  return inode->length;
 }
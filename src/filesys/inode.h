@@ -6,12 +6,22 @@
 #include "devices/disk.h"
 
 struct bitmap;
+struct tmpfs_node;
+
+/* Inode flags. */
+#define INODE_META 0x1          /* Contents are file system metadata. */
+#define INODE_COMPRESSED 0x2    /* Data is stored compressed. */
+#define INODE_DIR 0x4           /* Contents are a directory. */
 
 void inode_init (void);
-bool inode_create (disk_sector_t, off_t);
+bool inode_create (disk_sector_t, off_t, unsigned flags);
 struct inode *inode_open (disk_sector_t);
+struct inode *inode_open_tmpfs (struct tmpfs_node *);
 struct inode *inode_reopen (struct inode *);
 disk_sector_t inode_get_inumber (const struct inode *);
+bool inode_is_dir (const struct inode *);
+bool inode_is_removed (const struct inode *);
+int inode_open_cnt (const struct inode *);
 void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
@@ -19,5 +29,10 @@ off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
+void inode_flush_all (void);
+size_t inode_extent (struct inode *, disk_sector_t *start);
+bool inode_move (struct inode *, disk_sector_t start);
+bool inode_compression (struct inode *, size_t *stored, size_t *logical);
+bool inode_clone (struct inode *, disk_sector_t);
 
 #endif /* filesys/inode.h */
@@ -0,0 +1,768 @@
+#include "filesys/journal.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Write-ahead journal for file system metadata.
+
+   Metadata sectors (inodes, directory contents, and the free
+   map) are not written in place when they change.  Instead,
+   journal_write() keeps the new contents in memory as part of
+   the running transaction.  Each file system operation brackets
+   its changes with journal_begin() and journal_end(), and a
+   transaction is only committed while no operation is in
+   progress, so every operation is atomic.
+
+   Committing writes all the sectors changed by a transaction,
+   preceded by a descriptor sector, to the next free part of a
+   circular log as a single sequential disk request.  Many
+   operations usually share one transaction: the journal thread
+   commits the running transaction every COMMIT_INTERVAL timer
+   ticks, and journal_begin() commits it early once it has grown
+   to COMMIT_SECTORS sectors.
+
+   Committed sectors stay in memory, where journal_read() finds
+   them, until a checkpoint writes them to their home locations
+   and empties the log.  Checkpoints happen only when the log is
+   nearly full and at shutdown, so a sector that changes many
+   times is written in place only once.
+
+   After a crash, journal_init() replays every complete
+   transaction in the log, in order.  A transaction is complete
+   if its descriptor carries the expected sequence number and a
+   checksum that matches the data that follows it.
+
+   An operation that changes more than TXN_MAX sectors cannot be
+   committed atomically.  Such an operation calls journal_reserve()
+   at points where the disk would be consistent, which commits the
+   running transaction early if it is nearly full.  As a last
+   resort, rather than stopping the kernel, journal_write() does
+   the same wherever the limit is reached.
+
+   A sector whose latest contents are in the journal must not be
+   reused for file data before the next checkpoint, or replay
+   could overwrite that data.  journal_defer_release() holds back
+   frees of such sectors until then.
+
+   Similarly, data sectors that an operation stops using, such as
+   the old run of a file that moves, must not be reused before the
+   transaction that stops using them commits, or a crash could
+   leave the old inode pointing to someone else's data.
+   journal_release_after_commit() holds back those frees until
+   the commit.
+
+   On-disk layout: sector JOURNAL_SECTOR holds a header that
+   locates the log and records where replay must begin.  The
+   log itself is a contiguous run of sectors allocated at format
+   time.  A disk formatted without a journal has no valid header
+   there and is updated in place, as before. */
+
+/* Identifies a journal header and a log descriptor. */
+#define HEADER_MAGIC 0x4a524e4c
+#define DESC_MAGIC 0x4a444553
+
+/* Size of log allocated at format time, in sectors. */
+#define LOG_SECTORS 128
+
+/* Maximum number of sectors in one transaction. */
+#define TXN_MAX 62
+
+/* Commit the running transaction early once it has this many
+   sectors. */
+#define COMMIT_SECTORS 32
+
+/* Interval between group commits, in timer ticks. */
+#define COMMIT_INTERVAL TIMER_FREQ
+
+/* Journal header, in sector JOURNAL_SECTOR.
+   Must be exactly DISK_SECTOR_SIZE bytes long. */
+struct journal_header
+  {
+    unsigned magic;             /* HEADER_MAGIC. */
+    disk_sector_t start;        /* First sector of log. */
+    uint32_t size;              /* Number of sectors in log. */
+    uint32_t tail;              /* Offset in log where replay starts. */
+    uint32_t tail_seq;          /* Sequence number expected at TAIL. */
+    uint32_t unused[123];       /* Not used. */
+  };
+
+/* Log descriptor, which precedes the CNT sectors of data of
+   transaction SEQ.  Must be exactly DISK_SECTOR_SIZE bytes
+   long. */
+struct journal_desc
+  {
+    unsigned magic;             /* DESC_MAGIC. */
+    uint32_t seq;               /* Transaction sequence number. */
+    uint32_t cnt;               /* Number of data sectors. */
+    unsigned checksum;          /* hash_bytes() of the data sectors. */
+    disk_sector_t targets[TXN_MAX];     /* Home of each data sector. */
+    uint32_t unused[128 - 4 - TXN_MAX]; /* Not used. */
+  };
+
+/* The latest contents of a metadata sector that has not been
+   checkpointed. */
+struct jbuf
+  {
+    struct hash_elem hash_elem; /* Element in `bufs'. */
+    struct list_elem list_elem; /* Element in `txn' or checkpoint list. */
+    disk_sector_t sector;       /* Home sector. */
+    bool in_txn;                /* In running transaction? */
+    uint8_t data[DISK_SECTOR_SIZE];     /* Contents. */
+  };
+
+/* A range of sectors whose release is deferred to the next
+   commit or checkpoint. */
+struct deferred_release
+  {
+    struct list_elem elem;      /* Element in a deferred list. */
+    disk_sector_t sector;       /* First sector. */
+    size_t cnt;                 /* Number of sectors. */
+  };
+
+/* True if the journal is in use. */
+static bool active;
+
+/* Protects all the following. */
+static struct lock journal_lock;
+
+/* Log location, from header. */
+static disk_sector_t log_start;
+static size_t log_size;
+
+/* Log state.  HEAD is the offset at which the next transaction
+   will be written, HEAD_SEQ its sequence number, and USED the
+   number of log sectors in use or skipped since the last
+   checkpoint. */
+static size_t head;
+static uint32_t head_seq;
+static size_t used;
+
+/* Uncheckpointed sectors, and those in the running
+   transaction. */
+static struct hash bufs;
+static struct list txn;
+static size_t txn_cnt;
+
+/* Number of operations between journal_begin() and
+   journal_end(). */
+static int handle_cnt;
+
+/* Sector ranges to release after the next checkpoint. */
+static struct list deferred;
+
+/* Sector ranges to release after the running transaction
+   commits, and those whose transaction has committed. */
+static struct list uncommitted;
+static struct list committed;
+
+/* Buffer for one transaction: a descriptor plus TXN_MAX data
+   sectors. */
+#define LOG_BUF_PAGES DIV_ROUND_UP ((TXN_MAX + 1) * DISK_SECTOR_SIZE, PGSIZE)
+static uint8_t *log_buf;
+
+/* Statistics. */
+static long long commit_cnt;            /* Transactions committed. */
+static long long logged_cnt;            /* Sectors written to log. */
+static long long checkpoint_cnt;        /* Checkpoints. */
+static long long checkpointed_cnt;      /* Sectors written in place. */
+static long long replay_cnt;            /* Transactions replayed. */
+static long long split_cnt;             /* Operations split by commits. */
+
+static hash_hash_func jbuf_hash;
+static hash_less_func jbuf_less;
+static void split (void);
+static void commit (void);
+static void checkpoint (void);
+static void write_header (uint32_t tail, uint32_t tail_seq);
+static void replay (uint32_t tail, uint32_t tail_seq);
+static bool read_txn (size_t ofs, uint32_t seq);
+static void release_deferred (struct list *);
+static thread_func journal_thread;
+
+/* Creates an empty journal on the file system disk.  Called
+   while formatting, after the free map has been created. */
+void
+journal_create (void)
+{
+  struct journal_header *h;
+  disk_sector_t start;
+  size_t size = LOG_SECTORS;
+
+  ASSERT (sizeof *h == DISK_SECTOR_SIZE);
+  h = calloc (1, sizeof *h);
+  if (h == NULL)
+    PANIC ("journal: out of memory");
+
+  /* Without room for a journal, write a header without a valid
+     magic number, so that no old journal is replayed. */
+  if (size > disk_size (filesys_disk) / 8)
+    size = disk_size (filesys_disk) / 8;
+  if (size >= 2 * (TXN_MAX + 1) && free_map_allocate (size, &start))
+    {
+      h->magic = HEADER_MAGIC;
+      h->start = start;
+      h->size = size;
+      h->tail = 0;
+      h->tail_seq = 1;
+    }
+  else
+    printf ("journal: disk too small, not creating journal\n");
+  disk_write (filesys_disk, JOURNAL_SECTOR, h);
+  free (h);
+}
+
+/* Opens the journal on the file system disk, if it has one,
+   replays any transactions left in it, and starts journaling
+   metadata writes. */
+void
+journal_init (void)
+{
+  struct journal_header *h;
+  uint32_t tail, tail_seq;
+
+  ASSERT (sizeof (struct journal_desc) == DISK_SECTOR_SIZE);
+
+  h = malloc (sizeof *h);
+  if (h == NULL)
+    PANIC ("journal: out of memory");
+  disk_read (filesys_disk, JOURNAL_SECTOR, h);
+  if (h->magic != HEADER_MAGIC || h->size < 2 * (TXN_MAX + 1)
+      || h->start >= disk_size (filesys_disk)
+      || h->size > disk_size (filesys_disk) - h->start)
+    {
+      printf ("journal: none found, updating metadata in place\n");
+      free (h);
+      return;
+    }
+  log_start = h->start;
+  log_size = h->size;
+  tail = h->tail;
+  tail_seq = h->tail_seq;
+  free (h);
+
+  lock_init (&journal_lock);
+  hash_init (&bufs, jbuf_hash, jbuf_less, NULL);
+  list_init (&txn);
+  list_init (&deferred);
+  list_init (&uncommitted);
+  list_init (&committed);
+  log_buf = palloc_get_multiple (PAL_ASSERT, LOG_BUF_PAGES);
+
+  replay (tail, tail_seq);
+
+  active = true;
+  thread_create ("journal", PRI_DEFAULT, journal_thread, NULL);
+}
+
+/* Commits any running transaction, writes all journaled sectors
+   in place, and stops journaling. */
+void
+journal_done (void)
+{
+  if (!active)
+    return;
+
+  lock_acquire (&journal_lock);
+  ASSERT (handle_cnt == 0);
+  if (txn_cnt > 0)
+    commit ();
+  checkpoint ();
+  active = false;
+  lock_release (&journal_lock);
+
+  /* Metadata is now written in place, so deferred releases may
+     go straight to the free map. */
+  release_deferred (&uncommitted);
+  release_deferred (&committed);
+  release_deferred (&deferred);
+}
+
+/* Begins a file system operation whose metadata changes must
+   reach the disk atomically.  Calls may nest. */
+void
+journal_begin (void)
+{
+  bool checkpointed = false;
+
+  if (!active)
+    return;
+
+  lock_acquire (&journal_lock);
+  if (handle_cnt == 0)
+    {
+      if (txn_cnt >= COMMIT_SECTORS)
+        commit ();
+
+      /* Make sure the transaction we are about to start will fit
+         in the log, even if it must skip to the beginning. */
+      if (txn_cnt == 0 && log_size - used < 2 * (TXN_MAX + 1))
+        {
+          checkpoint ();
+          checkpointed = true;
+        }
+    }
+  handle_cnt++;
+  lock_release (&journal_lock);
+
+  release_deferred (&committed);
+  if (checkpointed)
+    release_deferred (&deferred);
+}
+
+/* Ends a file system operation begun with journal_begin(). */
+void
+journal_end (void)
+{
+  if (!active)
+    return;
+
+  lock_acquire (&journal_lock);
+  ASSERT (handle_cnt > 0);
+  handle_cnt--;
+  lock_release (&journal_lock);
+}
+
+/* Reads metadata sector SECTOR into BUFFER, seeing any changes
+   that have not yet been checkpointed. */
+void
+journal_read (disk_sector_t sector, void *buffer)
+{
+  if (active)
+    {
+      struct jbuf key;
+      struct hash_elem *e;
+
+      lock_acquire (&journal_lock);
+      key.sector = sector;
+      e = hash_find (&bufs, &key.hash_elem);
+      if (e != NULL)
+        {
+          memcpy (buffer, hash_entry (e, struct jbuf, hash_elem)->data,
+                  DISK_SECTOR_SIZE);
+          lock_release (&journal_lock);
+          return;
+        }
+      lock_release (&journal_lock);
+    }
+  disk_read (filesys_disk, sector, buffer);
+}
+
+/* Writes BUFFER to metadata sector SECTOR as part of the running
+   transaction.  Must be called between journal_begin() and
+   journal_end(). */
+void
+journal_write (disk_sector_t sector, const void *buffer)
+{
+  struct jbuf key, *b;
+  struct hash_elem *e;
+
+  if (!active)
+    {
+      disk_write (filesys_disk, sector, buffer);
+      return;
+    }
+
+  lock_acquire (&journal_lock);
+  ASSERT (handle_cnt > 0);
+  key.sector = sector;
+  e = hash_find (&bufs, &key.hash_elem);
+
+  /* If SECTOR would overflow the running transaction, split it.
+     A checkpoint frees every jbuf, so look SECTOR up again. */
+  if ((e == NULL || !hash_entry (e, struct jbuf, hash_elem)->in_txn)
+      && txn_cnt >= TXN_MAX)
+    {
+      split ();
+      e = hash_find (&bufs, &key.hash_elem);
+    }
+
+  if (e != NULL)
+    b = hash_entry (e, struct jbuf, hash_elem);
+  else
+    {
+      b = malloc (sizeof *b);
+      if (b == NULL)
+        PANIC ("journal: out of memory");
+      b->sector = sector;
+      b->in_txn = false;
+      hash_insert (&bufs, &b->hash_elem);
+    }
+  memcpy (b->data, buffer, DISK_SECTOR_SIZE);
+  if (!b->in_txn)
+    {
+      b->in_txn = true;
+      list_push_back (&txn, &b->list_elem);
+      txn_cnt++;
+    }
+  lock_release (&journal_lock);
+}
+
+/* Makes sure that the running transaction has room for CNT more
+   sectors, by committing it now if it does not.  An operation
+   that may change more than TXN_MAX sectors calls this at points
+   where the disk would be consistent if the operation went no
+   further.  Must be called between journal_begin() and
+   journal_end(). */
+void
+journal_reserve (size_t cnt)
+{
+  if (!active)
+    return;
+
+  ASSERT (cnt <= TXN_MAX);
+  lock_acquire (&journal_lock);
+  ASSERT (handle_cnt > 0);
+  if (txn_cnt + cnt > TXN_MAX)
+    split ();
+  lock_release (&journal_lock);
+}
+
+/* Commits the running transaction now, so that the changes
+   made so far reach the disk before the caller goes on.  Must be
+   called between journal_begin() and journal_end(), at a point
+   where the disk would be consistent if the operation went no
+   further. */
+void
+journal_commit (void)
+{
+  if (!active)
+    return;
+
+  lock_acquire (&journal_lock);
+  ASSERT (handle_cnt > 0);
+  if (txn_cnt > 0) 
+    {
+      commit ();
+      if (log_size - used < 2 * (TXN_MAX + 1))
+        checkpoint ();
+    }
+  lock_release (&journal_lock);
+}
+
+/* If any of the CNT sectors starting at SECTOR has journaled
+   contents that have not been checkpointed, arranges for the
+   sectors to be released after the next checkpoint and returns
+   true.  Otherwise, returns false, and the caller should release
+   the sectors right away. */
+bool
+journal_defer_release (disk_sector_t sector, size_t cnt)
+{
+  struct deferred_release *d;
+  bool defer = false;
+  size_t i;
+
+  if (!active)
+    return false;
+
+  lock_acquire (&journal_lock);
+  for (i = 0; i < cnt && !defer; i++)
+    {
+      struct jbuf key;
+      key.sector = sector + i;
+      defer = hash_find (&bufs, &key.hash_elem) != NULL;
+    }
+  if (defer)
+    {
+      d = malloc (sizeof *d);
+      if (d == NULL)
+        PANIC ("journal: out of memory");
+      d->sector = sector;
+      d->cnt = cnt;
+      list_push_back (&deferred, &d->elem);
+    }
+  lock_release (&journal_lock);
+  return defer;
+}
+
+/* Releases the CNT sectors starting at SECTOR once the running
+   transaction commits, so that they are not reused while the
+   disk may still refer to them.  Must be called between
+   journal_begin() and journal_end(). */
+void
+journal_release_after_commit (disk_sector_t sector, size_t cnt)
+{
+  struct deferred_release *d;
+
+  if (!active)
+    {
+      free_map_release (sector, cnt);
+      return;
+    }
+
+  d = malloc (sizeof *d);
+  if (d == NULL)
+    PANIC ("journal: out of memory");
+  d->sector = sector;
+  d->cnt = cnt;
+  lock_acquire (&journal_lock);
+  ASSERT (handle_cnt > 0);
+  list_push_back (&uncommitted, &d->elem);
+  lock_release (&journal_lock);
+}
+
+/* Prints journal statistics. */
+void
+journal_print_stats (void)
+{
+  if (log_size > 0)
+    printf ("journal: %lld commits of %lld sectors, "
+            "%lld checkpoints of %lld sectors, %lld replayed, "
+            "%lld operations split\n",
+            commit_cnt, logged_cnt, checkpoint_cnt, checkpointed_cnt,
+            replay_cnt, split_cnt);
+}
+
+/* Commits the running transaction in the middle of an operation
+   that is too big for one, as though the operations in progress
+   had ended, and makes sure the log has room for the next
+   transaction.  The caller must hold journal_lock. */
+static void
+split (void)
+{
+  commit ();
+  if (log_size - used < 2 * (TXN_MAX + 1))
+    checkpoint ();
+  split_cnt++;
+}
+
+/* Writes the running transaction to the log.  The caller must
+   hold journal_lock.  No operation should be in progress, except
+   when split() commits part of one. */
+static void
+commit (void)
+{
+  struct journal_desc *desc = (struct journal_desc *) log_buf;
+  uint8_t *data = log_buf + DISK_SECTOR_SIZE;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+  ASSERT (txn_cnt > 0 && txn_cnt <= TXN_MAX);
+
+  /* Gather descriptor and data. */
+  memset (desc, 0, sizeof *desc);
+  desc->magic = DESC_MAGIC;
+  desc->seq = head_seq;
+  desc->cnt = txn_cnt;
+  for (i = 0; !list_empty (&txn); i++)
+    {
+      struct jbuf *b = list_entry (list_pop_front (&txn),
+                                   struct jbuf, list_elem);
+      desc->targets[i] = b->sector;
+      memcpy (data + i * DISK_SECTOR_SIZE, b->data, DISK_SECTOR_SIZE);
+      b->in_txn = false;
+    }
+  desc->checksum = hash_bytes (data, txn_cnt * DISK_SECTOR_SIZE);
+
+  /* Skip to the beginning of the log if the transaction does not
+     fit before its end.  journal_begin() made sure there is
+     room either way. */
+  if (head + txn_cnt + 1 > log_size)
+    {
+      used += log_size - head;
+      head = 0;
+    }
+  ASSERT (used + txn_cnt + 1 <= log_size);
+
+  disk_write_sectors (filesys_disk, log_start + head, txn_cnt + 1, log_buf);
+  head += txn_cnt + 1;
+  used += txn_cnt + 1;
+  head_seq++;
+
+  commit_cnt++;
+  logged_cnt += txn_cnt;
+  txn_cnt = 0;
+
+  /* What the transaction stopped using may now be released. */
+  while (!list_empty (&uncommitted))
+    list_push_back (&committed, list_pop_front (&uncommitted));
+}
+
+/* Returns true if jbuf A's sector precedes jbuf B's. */
+static bool
+sector_less (const struct list_elem *a_, const struct list_elem *b_,
+             void *aux UNUSED)
+{
+  const struct jbuf *a = list_entry (a_, struct jbuf, list_elem);
+  const struct jbuf *b = list_entry (b_, struct jbuf, list_elem);
+  return a->sector < b->sector;
+}
+
+/* Writes every committed sector to its home location, in
+   ascending order so that the disk sees a single sweep, then
+   empties the log.  The caller must hold journal_lock, and the
+   running transaction must be empty. */
+static void
+checkpoint (void)
+{
+  struct hash_iterator i;
+  struct list sorted;
+
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+  ASSERT (txn_cnt == 0);
+
+  list_init (&sorted);
+  hash_first (&i, &bufs);
+  while (hash_next (&i))
+    list_insert_ordered (&sorted,
+                         &hash_entry (hash_cur (&i), struct jbuf,
+                                      hash_elem)->list_elem,
+                         sector_less, NULL);
+  hash_clear (&bufs, NULL);
+  while (!list_empty (&sorted))
+    {
+      struct jbuf *b = list_entry (list_pop_front (&sorted),
+                                   struct jbuf, list_elem);
+      disk_write (filesys_disk, b->sector, b->data);
+      checkpointed_cnt++;
+      free (b);
+    }
+
+  /* Everything in the log is now on disk, so start over. */
+  head = used = 0;
+  write_header (0, head_seq);
+  checkpoint_cnt++;
+}
+
+/* Writes a journal header that locates the log and records
+   that replay must begin at offset TAIL with sequence number
+   TAIL_SEQ. */
+static void
+write_header (uint32_t tail, uint32_t tail_seq)
+{
+  struct journal_header *h = (struct journal_header *) log_buf;
+
+  memset (h, 0, sizeof *h);
+  h->magic = HEADER_MAGIC;
+  h->start = log_start;
+  h->size = log_size;
+  h->tail = tail;
+  h->tail_seq = tail_seq;
+  disk_write (filesys_disk, JOURNAL_SECTOR, h);
+}
+
+/* Replays the complete transactions in the log, starting from
+   offset TAIL with sequence number TAIL_SEQ, then marks the log
+   empty. */
+static void
+replay (uint32_t tail, uint32_t tail_seq)
+{
+  struct journal_desc *desc = (struct journal_desc *) log_buf;
+  size_t ofs = tail;
+  uint32_t seq = tail_seq;
+
+  for (;;)
+    {
+      size_t i;
+
+      /* A transaction that did not fit before the end of the log
+         was written at its beginning. */
+      if (!read_txn (ofs, seq))
+        {
+          if (ofs == 0 || !read_txn (0, seq))
+            break;
+          ofs = 0;
+        }
+
+      for (i = 0; i < desc->cnt; i++)
+        disk_write (filesys_disk, desc->targets[i],
+                    log_buf + (i + 1) * DISK_SECTOR_SIZE);
+      ofs += desc->cnt + 1;
+      seq++;
+      replay_cnt++;
+    }
+
+  if (replay_cnt > 0)
+    printf ("journal: replayed %lld transactions\n", replay_cnt);
+  head = used = 0;
+  head_seq = seq;
+  write_header (0, head_seq);
+}
+
+/* Reads the transaction at offset OFS in the log into log_buf.
+   Returns true if it is a complete transaction with sequence
+   number SEQ, false otherwise. */
+static bool
+read_txn (size_t ofs, uint32_t seq)
+{
+  struct journal_desc *desc = (struct journal_desc *) log_buf;
+  uint8_t *data = log_buf + DISK_SECTOR_SIZE;
+
+  if (ofs >= log_size)
+    return false;
+  disk_read (filesys_disk, log_start + ofs, desc);
+  if (desc->magic != DESC_MAGIC || desc->seq != seq
+      || desc->cnt == 0 || desc->cnt > TXN_MAX
+      || ofs + desc->cnt + 1 > log_size)
+    return false;
+  disk_read_sectors (filesys_disk, log_start + ofs + 1, desc->cnt, data);
+  return hash_bytes (data, desc->cnt * DISK_SECTOR_SIZE) == desc->checksum;
+}
+
+/* Releases the sector ranges in LIST, one of the lists of
+   deferred releases. */
+static void
+release_deferred (struct list *list)
+{
+  struct list ready;
+
+  list_init (&ready);
+  if (active)
+    lock_acquire (&journal_lock);
+  while (!list_empty (list))
+    list_push_back (&ready, list_pop_front (list));
+  if (active)
+    lock_release (&journal_lock);
+
+  while (!list_empty (&ready))
+    {
+      struct deferred_release *d
+        = list_entry (list_pop_front (&ready),
+                      struct deferred_release, elem);
+      free_map_release (d->sector, d->cnt);
+      free (d);
+    }
+}
+
+/* Group commit thread: commits the running transaction every
+   COMMIT_INTERVAL ticks, if no operation is in progress. */
+static void
+journal_thread (void *aux UNUSED)
+{
+  while (active)
+    {
+      timer_sleep (COMMIT_INTERVAL);
+      lock_acquire (&journal_lock);
+      if (active && handle_cnt == 0 && txn_cnt > 0)
+        commit ();
+      lock_release (&journal_lock);
+    }
+}
+
+/* Returns a hash value for jbuf E. */
+static unsigned
+jbuf_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct jbuf *b = hash_entry (e, struct jbuf, hash_elem);
+  return hash_int (b->sector);
+}
+
+/* Returns true if jbuf A's sector precedes jbuf B's. */
+static bool
+jbuf_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct jbuf *a = hash_entry (a_, struct jbuf, hash_elem);
+  const struct jbuf *b = hash_entry (b_, struct jbuf, hash_elem);
+  return a->sector < b->sector;
+}
@@ -0,0 +1,23 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/disk.h"
+
+void journal_create (void);
+void journal_init (void);
+void journal_done (void);
+
+void journal_begin (void);
+void journal_end (void);
+void journal_read (disk_sector_t, void *);
+void journal_write (disk_sector_t, const void *);
+void journal_reserve (size_t cnt);
+void journal_commit (void);
+bool journal_defer_release (disk_sector_t, size_t cnt);
+void journal_release_after_commit (disk_sector_t, size_t cnt);
+
+void journal_print_stats (void);
+
+#endif /* filesys/journal.h */
@@ -0,0 +1,339 @@
+#include "filesys/tmpfs.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* An in-memory file system for temporary files, enabled with
+   the kernel command-line option "-tmpfs=KB".
+
+   Files whose names start with TMPFS_PREFIX are created here
+   instead of on the file system disk.  Their inodes and data
+   live only in kernel memory, so creating, writing, reading, and
+   deleting them never touches a disk, and they vanish at power
+   off.  Opening a tmpfs file yields an ordinary `struct inode',
+   which the inode module forwards to the functions below, so
+   the file_*() interface works unchanged.
+
+   Data pages are allocated as they are first written, so files
+   may be sparse, and unlike files on disk, tmpfs files grow when
+   written past their end.  All data pages together may occupy
+   at most the number of kB given on the command line.
+
+   Like the rest of the file system, this module does no locking
+   of its own; callers must serialize access. */
+
+/* A file in tmpfs. */
+struct tmpfs_node
+  {
+    struct list_elem elem;      /* Element in `nodes' if linked. */
+    char name[NAME_MAX + 1];    /* Name, without TMPFS_PREFIX. */
+    disk_sector_t inumber;      /* Inode number. */
+    off_t length;               /* File size in bytes. */
+    uint8_t **pages;            /* Data pages; null entries are holes. */
+    size_t page_cnt;            /* Number of elements in PAGES. */
+  };
+
+/* Files, in order of creation. */
+static struct list nodes;
+
+/* True if tmpfs is enabled. */
+static bool enabled;
+
+/* Memory limit and usage, in pages. */
+static size_t cap_pages;
+static size_t used_pages;
+static size_t peak_pages;
+
+/* Next inode number to hand out.  Tmpfs inode numbers count down
+   from the top of the sector number space, so that they cannot
+   collide with inode numbers on disk. */
+static disk_sector_t next_inumber = (disk_sector_t) -1;
+
+/* Statistics. */
+static long long create_cnt;    /* Files created. */
+static long long alloc_fail_cnt;        /* Writes cut short by cap. */
+
+static struct tmpfs_node *lookup (const char *name);
+static uint8_t *get_page (struct tmpfs_node *, size_t page_idx, bool create);
+
+/* Enables tmpfs, allowing it to use up to CAP_KB kB of memory
+   for file data. */
+void
+tmpfs_init (size_t cap_kb)
+{
+  list_init (&nodes);
+  cap_pages = DIV_ROUND_UP (cap_kb, PGSIZE / 1024);
+  enabled = true;
+}
+
+/* If NAME names a file in tmpfs, returns the part of NAME
+   following TMPFS_PREFIX.  Otherwise, returns a null pointer. */
+const char *
+tmpfs_match (const char *name)
+{
+  size_t prefix_len = strlen (TMPFS_PREFIX);
+
+  if (!enabled || strlen (name) < prefix_len
+      || memcmp (name, TMPFS_PREFIX, prefix_len))
+    return NULL;
+  return name + prefix_len;
+}
+
+/* Creates a tmpfs file named NAME, which must not include
+   TMPFS_PREFIX, with INITIAL_SIZE bytes of zeros.  Returns true
+   if successful, false if NAME is invalid or already exists, or
+   if memory allocation fails. */
+bool
+tmpfs_create (const char *name, off_t initial_size)
+{
+  struct tmpfs_node *node;
+
+  ASSERT (initial_size >= 0);
+
+  if (*name == '\0' || strlen (name) > NAME_MAX || lookup (name) != NULL)
+    return false;
+
+  node = calloc (1, sizeof *node);
+  if (node == NULL)
+    return false;
+  strlcpy (node->name, name, sizeof node->name);
+  node->inumber = next_inumber--;
+  node->length = initial_size;
+  list_push_back (&nodes, &node->elem);
+  create_cnt++;
+  return true;
+}
+
+/* Opens the tmpfs file named NAME, which must not include
+   TMPFS_PREFIX, and returns its inode.  Returns a null pointer if
+   there is no such file or if memory allocation fails. */
+struct inode *
+tmpfs_open (const char *name)
+{
+  struct tmpfs_node *node = lookup (name);
+  return node != NULL ? inode_open_tmpfs (node) : NULL;
+}
+
+/* Removes the tmpfs file named NAME, which must not include
+   TMPFS_PREFIX.  Its memory is freed once it is no longer open.
+   Returns true if successful, false if there is no such file or
+   if memory allocation fails. */
+bool
+tmpfs_remove (const char *name)
+{
+  struct tmpfs_node *node = lookup (name);
+  struct inode *inode;
+
+  if (node == NULL)
+    return false;
+  inode = inode_open_tmpfs (node);
+  if (inode == NULL)
+    return false;
+
+  list_remove (&node->elem);
+  inode_remove (inode);
+  inode_close (inode);
+  return true;
+}
+
+/* Stores the name of the tmpfs file at position *POS, counting
+   from 0, into NAME, which has room for SIZE bytes, including
+   TMPFS_PREFIX, and advances *POS.  Returns true if successful,
+   false if there are no more files. */
+bool
+tmpfs_readdir (size_t *pos, char *name, size_t size)
+{
+  struct list_elem *e;
+  size_t i;
+
+  if (!enabled)
+    return false;
+  for (e = list_begin (&nodes), i = 0; e != list_end (&nodes);
+       e = list_next (e), i++)
+    if (i == *pos)
+      {
+        struct tmpfs_node *node = list_entry (e, struct tmpfs_node, elem);
+        snprintf (name, size, "%s%s", TMPFS_PREFIX, node->name);
+        ++*pos;
+        return true;
+      }
+  return false;
+}
+
+/* Prints tmpfs statistics. */
+void
+tmpfs_print_stats (void)
+{
+  if (enabled)
+    printf ("tmpfs: %lld files created, %zu of %zu kB in use "
+            "(peak %zu kB), %lld writes cut short\n",
+            create_cnt, used_pages * (PGSIZE / 1024),
+            cap_pages * (PGSIZE / 1024), peak_pages * (PGSIZE / 1024),
+            alloc_fail_cnt);
+}
+
+/* Returns NODE's inode number. */
+disk_sector_t
+tmpfs_inumber (const struct tmpfs_node *node)
+{
+  return node->inumber;
+}
+
+/* Returns the length, in bytes, of NODE's data. */
+off_t
+tmpfs_length (const struct tmpfs_node *node)
+{
+  return node->length;
+}
+
+/* Reads SIZE bytes from NODE into BUFFER, starting at OFFSET.
+   Returns the number of bytes actually read, which may be less
+   than SIZE if end of file is reached. */
+off_t
+tmpfs_read_at (struct tmpfs_node *node, void *buffer_, off_t size,
+               off_t offset)
+{
+  uint8_t *buffer = buffer_;
+  off_t bytes_read = 0;
+
+  while (size > 0 && offset < node->length)
+    {
+      uint8_t *page = get_page (node, offset / PGSIZE, false);
+      int page_ofs = offset % PGSIZE;
+
+      /* Bytes left in file, bytes left in page, lesser of the two. */
+      off_t file_left = node->length - offset;
+      int page_left = PGSIZE - page_ofs;
+      int min_left = file_left < page_left ? file_left : page_left;
+
+      /* Number of bytes to actually copy out of this page. */
+      int chunk_size = size < min_left ? size : min_left;
+
+      if (page != NULL)
+        memcpy (buffer + bytes_read, page + page_ofs, chunk_size);
+      else
+        memset (buffer + bytes_read, 0, chunk_size);
+
+      /* Advance. */
+      size -= chunk_size;
+      offset += chunk_size;
+      bytes_read += chunk_size;
+    }
+  return bytes_read;
+}
+
+/* Writes SIZE bytes from BUFFER into NODE, starting at OFFSET,
+   extending NODE if necessary.  Returns the number of bytes
+   actually written, which may be less than SIZE if memory runs
+   out or the tmpfs memory cap is reached. */
+off_t
+tmpfs_write_at (struct tmpfs_node *node, const void *buffer_, off_t size,
+                off_t offset)
+{
+  const uint8_t *buffer = buffer_;
+  off_t bytes_written = 0;
+
+  while (size > 0)
+    {
+      uint8_t *page = get_page (node, offset / PGSIZE, true);
+      int page_ofs = offset % PGSIZE;
+      int page_left = PGSIZE - page_ofs;
+      int chunk_size = size < page_left ? size : page_left;
+
+      if (page == NULL)
+        {
+          alloc_fail_cnt++;
+          break;
+        }
+      memcpy (page + page_ofs, buffer + bytes_written, chunk_size);
+
+      /* Advance. */
+      size -= chunk_size;
+      offset += chunk_size;
+      bytes_written += chunk_size;
+    }
+
+  if (offset > node->length && bytes_written > 0)
+    node->length = offset;
+  return bytes_written;
+}
+
+/* Frees NODE, which has been removed and is no longer open, and
+   all of its data. */
+void
+tmpfs_release (struct tmpfs_node *node)
+{
+  size_t i;
+
+  for (i = 0; i < node->page_cnt; i++)
+    if (node->pages[i] != NULL)
+      {
+        palloc_free_page (node->pages[i]);
+        used_pages--;
+      }
+  free (node->pages);
+  free (node);
+}
+
+/* Returns the tmpfs file named NAME, or a null pointer if there
+   is none. */
+static struct tmpfs_node *
+lookup (const char *name)
+{
+  struct list_elem *e;
+
+  if (!enabled)
+    return NULL;
+  for (e = list_begin (&nodes); e != list_end (&nodes); e = list_next (e))
+    {
+      struct tmpfs_node *node = list_entry (e, struct tmpfs_node, elem);
+      if (!strcmp (node->name, name))
+        return node;
+    }
+  return NULL;
+}
+
+/* Returns NODE's data page with index PAGE_IDX.  If the page has
+   never been written, then allocates a zeroed page if CREATE is
+   true, or returns a null pointer if CREATE is false.  Also
+   returns a null pointer if allocation fails or would exceed the
+   memory cap. */
+static uint8_t *
+get_page (struct tmpfs_node *node, size_t page_idx, bool create)
+{
+  if (page_idx >= node->page_cnt)
+    {
+      uint8_t **pages;
+      size_t page_cnt;
+
+      if (!create)
+        return NULL;
+
+      /* Grow the page array, at least doubling it. */
+      page_cnt = node->page_cnt * 2;
+      if (page_cnt <= page_idx)
+        page_cnt = page_idx + 1;
+      pages = realloc (node->pages, page_cnt * sizeof *pages);
+      if (pages == NULL)
+        return NULL;
+      memset (pages + node->page_cnt, 0,
+              (page_cnt - node->page_cnt) * sizeof *pages);
+      node->pages = pages;
+      node->page_cnt = page_cnt;
+    }
+
+  if (node->pages[page_idx] == NULL && create && used_pages < cap_pages)
+    {
+      node->pages[page_idx] = palloc_get_page (PAL_ZERO);
+      if (node->pages[page_idx] != NULL && ++used_pages > peak_pages)
+        peak_pages = used_pages;
+    }
+  return node->pages[page_idx];
+}
@@ -0,0 +1,31 @@
+#ifndef FILESYS_TMPFS_H
+#define FILESYS_TMPFS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "devices/disk.h"
+
+/* Names of files kept in tmpfs start with this prefix. */
+#define TMPFS_PREFIX "/tmp/"
+
+struct inode;
+struct tmpfs_node;
+
+void tmpfs_init (size_t cap_kb);
+const char *tmpfs_match (const char *name);
+bool tmpfs_create (const char *name, off_t initial_size);
+struct inode *tmpfs_open (const char *name);
+bool tmpfs_remove (const char *name);
+bool tmpfs_readdir (size_t *pos, char *name, size_t size);
+void tmpfs_print_stats (void);
+
+/* Used by the inode module for inodes backed by tmpfs nodes. */
+disk_sector_t tmpfs_inumber (const struct tmpfs_node *);
+off_t tmpfs_length (const struct tmpfs_node *);
+off_t tmpfs_read_at (struct tmpfs_node *, void *, off_t size, off_t offset);
+off_t tmpfs_write_at (struct tmpfs_node *, const void *, off_t size,
+                      off_t offset);
+void tmpfs_release (struct tmpfs_node *);
+
+#endif /* filesys/tmpfs.h */
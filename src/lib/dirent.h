@@ -0,0 +1,19 @@
+#ifndef __LIB_DIRENT_H
+#define __LIB_DIRENT_H
+
+#include <stdbool.h>
+
+/* Maximum length of a name in a struct dirent. */
+#define DIRENT_NAME_MAX 14
+
+/* A directory entry together with the attributes of the file it
+   names, as stored by the readdir_plus() system call. */
+struct dirent
+  {
+    int inumber;                        /* Inode number. */
+    int size;                           /* File size in bytes. */
+    bool is_dir;                        /* Is it a directory? */
+    char name[DIRENT_NAME_MAX + 1];     /* Null-terminated name. */
+  };
+
+#endif /* lib/dirent.h */
@@ -0,0 +1,223 @@
+#include "lz.h"
+#include <debug.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Number of entries in the compressor's hash table of positions,
+   each of which is a uint16_t. */
+#define HASH_BITS 10
+#define HASH_SIZE (1 << HASH_BITS)
+
+/* Largest value that fits in a token nibble.  Longer lengths are
+   continued in extra bytes. */
+#define NIBBLE_MAX 15
+
+static bool emit (uint8_t **opp, uint8_t *oend, const uint8_t *literals,
+                  size_t literal_cnt, size_t distance, size_t match_len);
+static bool put_length (uint8_t **opp, uint8_t *oend, size_t length);
+static bool get_length (const uint8_t **ipp, const uint8_t *iend,
+                        size_t *length);
+
+/* Returns the 4 bytes at P as a 32-bit value. */
+static inline uint32_t
+read32 (const uint8_t *p) 
+{
+  uint32_t value;
+  memcpy (&value, p, sizeof value);
+  return value;
+}
+
+/* Hashes VALUE into an index into the compressor's hash table. */
+static inline size_t
+hash32 (uint32_t value) 
+{
+  return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/* Compresses the SRC_SIZE bytes in SRC, at most LZ_MAX_INPUT,
+   into the DST_SIZE bytes at DST, using the LZ_WORK_SIZE bytes
+   at WORK as scratch space.  Returns the number of bytes of
+   compressed data, or 0 if they would not fit in DST_SIZE
+   bytes. */
+size_t
+lz_compress (const void *src_, size_t src_size,
+             void *dst_, size_t dst_size, void *work) 
+{
+  const uint8_t *src = src_;
+  const uint8_t *ip = src;
+  const uint8_t *anchor = src;
+  const uint8_t *end = src + src_size;
+  uint8_t *dst = dst_;
+  uint8_t *op = dst;
+  uint16_t *table = work;
+
+  ASSERT (src_size <= LZ_MAX_INPUT);
+  ASSERT (HASH_SIZE * sizeof *table <= LZ_WORK_SIZE);
+
+  memset (table, 0, HASH_SIZE * sizeof *table);
+  while (end - ip >= LZ_MIN_MATCH) 
+    {
+      uint32_t value = read32 (ip);
+      size_t h = hash32 (value);
+      const uint8_t *ref = src + table[h];
+
+      table[h] = ip - src;
+      if (ref < ip && read32 (ref) == value) 
+        {
+          /* Extend the match as far as it goes. */
+          const uint8_t *p = ip + LZ_MIN_MATCH;
+          const uint8_t *q = ref + LZ_MIN_MATCH;
+          while (p < end && *p == *q)
+            p++, q++;
+
+          if (!emit (&op, dst + dst_size, anchor, ip - anchor,
+                     ip - ref, p - ip))
+            return 0;
+          ip = anchor = p;
+        }
+      else
+        ip++;
+    }
+
+  /* Final record, literals only. */
+  if (!emit (&op, dst + dst_size, anchor, end - anchor, 0, 0))
+    return 0;
+  return op - dst;
+}
+
+/* Decompresses the SRC_SIZE bytes of compressed data in SRC into
+   the DST_SIZE bytes at DST.  Stops once DST is full, so SRC may
+   be followed by padding.  Returns the number of bytes of
+   decompressed data, or 0 if SRC is corrupt or decompresses to
+   more than DST_SIZE bytes. */
+size_t
+lz_decompress (const void *src_, size_t src_size,
+               void *dst_, size_t dst_size) 
+{
+  const uint8_t *ip = src_;
+  const uint8_t *iend = ip + src_size;
+  uint8_t *dst = dst_;
+  uint8_t *op = dst;
+  uint8_t *oend = dst + dst_size;
+
+  while (ip < iend && op < oend) 
+    {
+      unsigned token = *ip++;
+      size_t length, distance;
+
+      /* Literals. */
+      length = token >> 4;
+      if (!get_length (&ip, iend, &length)
+          || length > (size_t) (iend - ip)
+          || length > (size_t) (oend - op))
+        return 0;
+      memcpy (op, ip, length);
+      op += length;
+      ip += length;
+      if (ip == iend || op == oend)
+        break;
+
+      /* Match.  The source and destination may overlap, so copy
+         one byte at a time. */
+      if (iend - ip < 2)
+        return 0;
+      distance = ip[0] | (ip[1] << 8);
+      ip += 2;
+      length = token & NIBBLE_MAX;
+      if (distance == 0 || distance > (size_t) (op - dst)
+          || !get_length (&ip, iend, &length))
+        return 0;
+      length += LZ_MIN_MATCH;
+      if (length > (size_t) (oend - op))
+        return 0;
+      for (; length > 0; length--, op++)
+        *op = op[-distance];
+    }
+  return op - dst;
+}
+
+/* Appends a record with the LITERAL_CNT bytes at LITERALS
+   followed by a match of MATCH_LEN bytes DISTANCE bytes back, or
+   no match if MATCH_LEN is 0, at *OPP, advancing *OPP.  Returns
+   false if the record does not fit before OEND. */
+static bool
+emit (uint8_t **opp, uint8_t *oend, const uint8_t *literals,
+      size_t literal_cnt, size_t distance, size_t match_len) 
+{
+  uint8_t *op = *opp;
+  uint8_t *token;
+
+  if (op >= oend)
+    return false;
+  token = op++;
+  *token = (literal_cnt < NIBBLE_MAX ? literal_cnt : NIBBLE_MAX) << 4;
+  if (!put_length (&op, oend, literal_cnt)
+      || literal_cnt > (size_t) (oend - op))
+    return false;
+  memcpy (op, literals, literal_cnt);
+  op += literal_cnt;
+
+  if (match_len > 0) 
+    {
+      size_t length = match_len - LZ_MIN_MATCH;
+
+      ASSERT (match_len >= LZ_MIN_MATCH);
+      ASSERT (distance > 0 && distance <= 0xffff);
+      *token |= length < NIBBLE_MAX ? length : NIBBLE_MAX;
+      if (oend - op < 2)
+        return false;
+      *op++ = distance;
+      *op++ = distance >> 8;
+      if (!put_length (&op, oend, length))
+        return false;
+    }
+
+  *opp = op;
+  return true;
+}
+
+/* Appends the extra bytes, if any, needed to encode LENGTH after
+   a token nibble at *OPP, advancing *OPP.  Returns false if they
+   do not fit before OEND. */
+static bool
+put_length (uint8_t **opp, uint8_t *oend, size_t length) 
+{
+  uint8_t *op = *opp;
+
+  if (length < NIBBLE_MAX)
+    return true;
+  for (length -= NIBBLE_MAX; ; length -= 255) 
+    {
+      if (op >= oend)
+        return false;
+      if (length < 255) 
+        {
+          *op++ = length;
+          break;
+        }
+      *op++ = 255;
+    }
+  *opp = op;
+  return true;
+}
+
+/* Reads the extra bytes, if any, that continue the token nibble
+   value in *LENGTH from *IPP, advancing *IPP, and adds them into
+   *LENGTH.  Returns false if the data ends first. */
+static bool
+get_length (const uint8_t **ipp, const uint8_t *iend, size_t *length) 
+{
+  const uint8_t *ip = *ipp;
+
+  if (*length == NIBBLE_MAX)
+    for (;;) 
+      {
+        if (ip >= iend)
+          return false;
+        *length += *ip;
+        if (*ip++ != 255)
+          break;
+      }
+  *ipp = ip;
+  return true;
+}
@@ -0,0 +1,37 @@
+#ifndef __LIB_KERNEL_LZ_H
+#define __LIB_KERNEL_LZ_H
+
+/* Fast LZ77-class compression.
+
+   Compressed data is a sequence of records, each of which holds
+   a run of literal bytes to copy to the output followed by a
+   match, that is, a reference to bytes already output, given as
+   a distance back and a length.  The format is close to that of
+   LZ4: each record begins with a token byte whose high and low
+   nibbles give the literal and match lengths, extended by extra
+   bytes when a nibble is 15.  Matches are at least LZ_MIN_MATCH
+   bytes long and at most 65535 bytes back.  The final record
+   has literals only.
+
+   The compressor finds matches through a small hash table of
+   recent positions, so it is fast but does not find the best
+   matches.  Decompression is a simple copying loop. */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Minimum length of a match. */
+#define LZ_MIN_MATCH 4
+
+/* Size of the work area that lz_compress() needs. */
+#define LZ_WORK_SIZE 2048
+
+/* Maximum number of bytes that can be compressed at once. */
+#define LZ_MAX_INPUT 65535
+
+size_t lz_compress (const void *src, size_t src_size,
+                    void *dst, size_t dst_size, void *work);
+size_t lz_decompress (const void *src, size_t src_size,
+                      void *dst, size_t dst_size);
+
+#endif /* lib/kernel/lz.h */
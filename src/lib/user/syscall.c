@@ -182,3 +182,21 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+bool
+clone (const char *file, const char *new_file)
+{
+  return syscall2 (SYS_CLONE, file, new_file);
+}
+
+int
+readdir_plus (int fd, struct dirent *entries, int cnt)
+{
+  return syscall3 (SYS_READDIR_PLUS, fd, entries, cnt);
+}
+
+pid_t
+fork (void)
+{
+  return syscall0 (SYS_FORK);
+}
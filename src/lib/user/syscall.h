@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <dirent.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -45,4 +46,9 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+bool clone (const char *file, const char *new_file);
+int readdir_plus (int fd, struct dirent *entries, int cnt);
+pid_t fork (void);
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($copy) = random_bytes (5000);
+substr ($copy, 1000, 600) = 'b' x 600;
+check_archive ({"b" => [$copy]});
+pass;
@@ -0,0 +1,60 @@
+/* Clones a file, then writes to the clone and to the original
+   and checks that each write shows up in one file only.  Last,
+   removes the original and checks that the clone, which shared
+   its data, is intact. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Large enough that the data is not kept inside the inode. */
+#define FILE_SIZE 5000
+
+static char orig[FILE_SIZE];
+static char copy[FILE_SIZE];
+
+/* Writes SIZE bytes of BUF at offset OFS in FILE_NAME. */
+static void
+write_at (const char *file_name, const char *buf, size_t ofs, size_t size)
+{
+  int fd;
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  seek (fd, ofs);
+  CHECK (write (fd, buf + ofs, size) == (int) size,
+         "write %zu bytes at offset %zu in \"%s\"", size, ofs, file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+}
+
+void
+test_main (void) 
+{
+  random_init (0);
+  random_bytes (orig, sizeof orig);
+  memcpy (copy, orig, sizeof copy);
+
+  CHECK (create ("a", 0), "create \"a\"");
+  write_at ("a", orig, 0, sizeof orig);
+  CHECK (clone ("a", "b"), "clone \"a\" as \"b\"");
+  CHECK (!clone ("a", "b"), "clone \"a\" as \"b\" again (must fail)");
+  CHECK (!clone ("c", "d"), "clone missing \"c\" (must fail)");
+  check_file ("b", copy, sizeof copy);
+
+  /* Writing to the clone must not change the original. */
+  memset (copy + 1000, 'b', 600);
+  write_at ("b", copy, 1000, 600);
+  check_file ("a", orig, sizeof orig);
+  check_file ("b", copy, sizeof copy);
+
+  /* Nor the other way around. */
+  memset (orig + 4000, 'a', 100);
+  write_at ("a", orig, 4000, 100);
+  check_file ("a", orig, sizeof orig);
+  check_file ("b", copy, sizeof copy);
+
+  CHECK (remove ("a"), "remove \"a\"");
+  check_file ("b", copy, sizeof copy);
+}
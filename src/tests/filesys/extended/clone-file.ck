@@ -0,0 +1,41 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(clone-file) begin
+(clone-file) create "a"
+(clone-file) open "a"
+(clone-file) write 5000 bytes at offset 0 in "a"
+(clone-file) close "a"
+(clone-file) clone "a" as "b"
+(clone-file) clone "a" as "b" again (must fail)
+(clone-file) clone missing "c" (must fail)
+(clone-file) open "b" for verification
+(clone-file) verified contents of "b"
+(clone-file) close "b"
+(clone-file) open "b"
+(clone-file) write 600 bytes at offset 1000 in "b"
+(clone-file) close "b"
+(clone-file) open "a" for verification
+(clone-file) verified contents of "a"
+(clone-file) close "a"
+(clone-file) open "b" for verification
+(clone-file) verified contents of "b"
+(clone-file) close "b"
+(clone-file) open "a"
+(clone-file) write 100 bytes at offset 4000 in "a"
+(clone-file) close "a"
+(clone-file) open "a" for verification
+(clone-file) verified contents of "a"
+(clone-file) close "a"
+(clone-file) open "b" for verification
+(clone-file) verified contents of "b"
+(clone-file) close "b"
+(clone-file) remove "a"
+(clone-file) open "b" for verification
+(clone-file) verified contents of "b"
+(clone-file) close "b"
+(clone-file) end
+EOF
+pass;
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($rnd) = random_bytes (8096);
+my ($data) = join ('', map (chr (ord ('a') + int ($_ / 64) % 26),
+                           0...12287));
+substr ($data, $_, 1) = chr (ord ('A') + int ($_ / 32) % 26)
+  foreach 4096...12287;
+substr ($data, 2000, 4000) = substr ($rnd, 0, 4000);
+check_archive ({"c" => [$data]});
+pass;
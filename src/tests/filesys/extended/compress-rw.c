@@ -0,0 +1,71 @@
+/* Writes a file on a file system that compresses new files, then
+   rewrites parts of it so that its chunks change between
+   compressible and incompressible data, checking the whole file
+   after each step. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Three chunks of a compressed file. */
+#define FILE_SIZE 12288
+
+static char data[FILE_SIZE];
+static char rnd[8096];
+
+/* Fills SIZE bytes of DATA at OFS with text that compresses
+   well, made of runs of LEN copies of BASE, BASE + 1, .... */
+static void
+fill_pattern (size_t ofs, size_t size, char base, size_t len) 
+{
+  size_t i;
+
+  for (i = ofs; i < ofs + size; i++)
+    data[i] = base + (i / len) % 26;
+}
+
+/* Writes SIZE bytes of DATA at offset OFS in "c". */
+static void
+write_at (size_t ofs, size_t size)
+{
+  int fd;
+
+  CHECK ((fd = open ("c")) > 1, "open \"c\"");
+  seek (fd, ofs);
+  CHECK (write (fd, data + ofs, size) == (int) size,
+         "write %zu bytes at offset %zu", size, ofs);
+  msg ("close \"c\"");
+  close (fd);
+}
+
+void
+test_main (void) 
+{
+  random_init (0);
+  random_bytes (rnd, sizeof rnd);
+
+  CHECK (create ("c", 0), "create \"c\"");
+  fill_pattern (0, FILE_SIZE, 'a', 64);
+  write_at (0, FILE_SIZE);
+  check_file ("c", data, FILE_SIZE);
+
+  /* Compressed data replaces compressed data. */
+  fill_pattern (4096, 4096, 'A', 32);
+  write_at (4096, 4096);
+  check_file ("c", data, FILE_SIZE);
+
+  /* Random data across two chunks makes both of them bigger. */
+  memcpy (data + 2000, rnd, 4000);
+  write_at (2000, 4000);
+  check_file ("c", data, FILE_SIZE);
+
+  /* The last chunk stops compressing, then compresses again. */
+  memcpy (data + 8192, rnd + 4000, 4096);
+  write_at (8192, 4096);
+  check_file ("c", data, FILE_SIZE);
+  fill_pattern (8192, 4096, 'A', 32);
+  write_at (8192, 4096);
+  check_file ("c", data, FILE_SIZE);
+}
@@ -0,0 +1,40 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(compress-rw) begin
+(compress-rw) create "c"
+(compress-rw) open "c"
+(compress-rw) write 12288 bytes at offset 0
+(compress-rw) close "c"
+(compress-rw) open "c" for verification
+(compress-rw) verified contents of "c"
+(compress-rw) close "c"
+(compress-rw) open "c"
+(compress-rw) write 4096 bytes at offset 4096
+(compress-rw) close "c"
+(compress-rw) open "c" for verification
+(compress-rw) verified contents of "c"
+(compress-rw) close "c"
+(compress-rw) open "c"
+(compress-rw) write 4000 bytes at offset 2000
+(compress-rw) close "c"
+(compress-rw) open "c" for verification
+(compress-rw) verified contents of "c"
+(compress-rw) close "c"
+(compress-rw) open "c"
+(compress-rw) write 4096 bytes at offset 8192
+(compress-rw) close "c"
+(compress-rw) open "c" for verification
+(compress-rw) verified contents of "c"
+(compress-rw) close "c"
+(compress-rw) open "c"
+(compress-rw) write 4096 bytes at offset 8192
+(compress-rw) close "c"
+(compress-rw) open "c" for verification
+(compress-rw) verified contents of "c"
+(compress-rw) close "c"
+(compress-rw) end
+EOF
+pass;
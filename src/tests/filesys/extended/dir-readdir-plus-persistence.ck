@@ -0,0 +1,8 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($dir) = {"sub" => {}};
+$dir->{"f$_"} = ["\0" x $_] foreach 0...59;
+check_archive ({"d" => $dir});
+pass;
@@ -0,0 +1,90 @@
+/* Creates a directory with enough entries to span several
+   sectors, then lists it with readdir_plus() in batches of an
+   odd size, and checks that every file comes back exactly once,
+   with the right size, type, and inode number. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Number of files to create.  A subdirectory is created too. */
+#define FILE_CNT 60
+
+/* Entries to ask for per readdir_plus() call. */
+#define BATCH_CNT 7
+
+void
+test_main (void) 
+{
+  struct dirent entries[BATCH_CNT];
+  bool seen[FILE_CNT + 1];
+  int dir_fd, cnt, total = 0;
+  int i;
+
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+  msg ("creating %d files", FILE_CNT);
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "d/f%d", i);
+      if (!create (name, i))
+        fail ("create \"%s\" failed", name);
+      seen[i] = false;
+    }
+  CHECK (mkdir ("d/sub"), "mkdir \"d/sub\"");
+  seen[FILE_CNT] = false;
+
+  CHECK ((dir_fd = open ("d")) > 1, "open \"d\"");
+  msg ("reading entries");
+  while ((cnt = readdir_plus (dir_fd, entries, BATCH_CNT)) > 0)
+    {
+      int j;
+
+      if (cnt > BATCH_CNT)
+        fail ("readdir_plus returned %d entries, asked for %d",
+              cnt, BATCH_CNT);
+      for (j = 0; j < cnt; j++)
+        {
+          struct dirent *e = &entries[j];
+          char name[16];
+          int fd, idx;
+
+          /* Identify the entry. */
+          for (idx = 0; idx <= FILE_CNT; idx++)
+            {
+              if (idx < FILE_CNT)
+                snprintf (name, sizeof name, "f%d", idx);
+              else
+                strlcpy (name, "sub", sizeof name);
+              if (!strcmp (e->name, name))
+                break;
+            }
+          if (idx > FILE_CNT)
+            fail ("readdir_plus returned unexpected name \"%s\"", e->name);
+          if (seen[idx])
+            fail ("readdir_plus returned \"%s\" twice", e->name);
+          seen[idx] = true;
+          total++;
+
+          /* Check its attributes. */
+          if (e->is_dir != (idx == FILE_CNT))
+            fail ("\"%s\" has wrong type", e->name);
+          if (idx < FILE_CNT && e->size != idx)
+            fail ("\"%s\" has size %d, expected %d", e->name, e->size, idx);
+          snprintf (name, sizeof name, "d/%s", e->name);
+          fd = open (name);
+          if (fd < 2)
+            fail ("open \"%s\" failed", name);
+          if (inumber (fd) != e->inumber)
+            fail ("\"%s\" has inumber %d, expected %d",
+                  e->name, e->inumber, inumber (fd));
+          close (fd);
+        }
+    }
+  CHECK (total == FILE_CNT + 1, "read %d entries", FILE_CNT + 1);
+  CHECK (readdir_plus (dir_fd, entries, BATCH_CNT) == 0,
+         "readdir_plus at end of directory");
+  close (dir_fd);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-readdir-plus) begin
+(dir-readdir-plus) mkdir "d"
+(dir-readdir-plus) creating 60 files
+(dir-readdir-plus) mkdir "d/sub"
+(dir-readdir-plus) open "d"
+(dir-readdir-plus) reading entries
+(dir-readdir-plus) read 61 entries
+(dir-readdir-plus) readdir_plus at end of directory
+(dir-readdir-plus) end
+EOF
+pass;
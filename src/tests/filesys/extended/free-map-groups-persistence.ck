@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+# Returns the contents of a file of SIZE bytes written by
+# fill_file() with the given PREFIX.
+sub stamped {
+    my ($prefix, $size) = @_;
+    return join ('', map (sprintf ("%s%07d", $prefix, $_) x 64,
+                          0...$size / 512 - 1));
+}
+
+check_archive ({"b" => [stamped ('b', 2621440)],
+                "c" => [stamped ('c', 3145728)]});
+pass;
@@ -0,0 +1,107 @@
+/* Allocates and frees files that span several free map groups,
+   on a disk with several of them: creates a large file, grows a
+   second one by appending until it crosses into another group,
+   then removes the first one and creates a third in the space it
+   freed.  Checks the surviving files sector by sector. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define A_SIZE (4608 * 1024)    /* Spans three 2 MB groups. */
+#define B_SIZE (2560 * 1024)
+#define C_SIZE (3072 * 1024)
+#define PIECE_SIZE (64 * 1024)  /* Bytes written or read at once. */
+#define SECTOR_SIZE 512
+
+static char piece[PIECE_SIZE];
+static char check[PIECE_SIZE];
+
+/* Fills PIECE with the contents of the sectors of a file with
+   the given PREFIX that start at offset OFS.  Each sector holds
+   its prefix and number, over and over. */
+static void
+make_piece (char prefix, int ofs) 
+{
+  int i;
+
+  for (i = 0; i < PIECE_SIZE; i += 8)
+    {
+      char stamp[16];
+      snprintf (stamp, sizeof stamp, "%c%07d", prefix,
+                (ofs + i) / SECTOR_SIZE);
+      memcpy (piece + i, stamp, 8);
+    }
+}
+
+/* Writes SIZE bytes of sectors with the given PREFIX to
+   FILE_NAME, from its beginning. */
+static void
+fill_file (const char *file_name, char prefix, int size) 
+{
+  int fd, ofs;
+
+  fd = open (file_name);
+  if (fd < 2)
+    fail ("open \"%s\" failed", file_name);
+  for (ofs = 0; ofs < size; ofs += PIECE_SIZE) 
+    {
+      make_piece (prefix, ofs);
+      if (write (fd, piece, PIECE_SIZE) != PIECE_SIZE)
+        fail ("write %d bytes at offset %d in \"%s\" failed",
+              PIECE_SIZE, ofs, file_name);
+    }
+  close (fd);
+}
+
+/* Checks that FILE_NAME is SIZE bytes long and holds the sectors
+   that fill_file() writes with the given PREFIX. */
+static void
+verify_file (const char *file_name, char prefix, int size) 
+{
+  int fd, ofs;
+
+  msg ("verify \"%s\"", file_name);
+  fd = open (file_name);
+  if (fd < 2)
+    fail ("open \"%s\" failed", file_name);
+  if (filesize (fd) != size)
+    fail ("\"%s\" is %d bytes long, not %d", file_name, filesize (fd), size);
+  for (ofs = 0; ofs < size; ofs += PIECE_SIZE) 
+    {
+      make_piece (prefix, ofs);
+      if (read (fd, check, PIECE_SIZE) != PIECE_SIZE
+          || memcmp (check, piece, PIECE_SIZE))
+        fail ("\"%s\" has the wrong contents at offset %d", file_name, ofs);
+    }
+  close (fd);
+}
+
+void
+test_main (void) 
+{
+  int fd;
+
+  CHECK (create ("a", A_SIZE), "create \"a\"");
+  CHECK ((fd = open ("a")) > 1, "open \"a\"");
+  seek (fd, A_SIZE - SECTOR_SIZE);
+  make_piece ('a', 0);
+  CHECK (write (fd, piece, SECTOR_SIZE) == SECTOR_SIZE,
+         "write the last sector of \"a\"");
+  msg ("close \"a\"");
+  close (fd);
+
+  CHECK (create ("b", 0), "create \"b\"");
+  msg ("grow \"b\" to %d bytes", B_SIZE);
+  fill_file ("b", 'b', B_SIZE);
+  verify_file ("b", 'b', B_SIZE);
+
+  CHECK (remove ("a"), "remove \"a\"");
+  CHECK (create ("c", C_SIZE), "create \"c\"");
+  msg ("fill \"c\"");
+  fill_file ("c", 'c', C_SIZE);
+  verify_file ("c", 'c', C_SIZE);
+  verify_file ("b", 'b', B_SIZE);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(free-map-groups) begin
+(free-map-groups) create "a"
+(free-map-groups) open "a"
+(free-map-groups) write the last sector of "a"
+(free-map-groups) close "a"
+(free-map-groups) create "b"
+(free-map-groups) grow "b" to 2621440 bytes
+(free-map-groups) verify "b"
+(free-map-groups) remove "a"
+(free-map-groups) create "c"
+(free-map-groups) fill "c"
+(free-map-groups) verify "c"
+(free-map-groups) verify "b"
+(free-map-groups) end
+EOF
+pass;
@@ -0,0 +1,79 @@
+/* Appends to two files in small pieces, alternately, closing and
+   reopening them halfway, and checks their contents.  The files
+   grow past the amount of data the kernel keeps delayed in
+   memory, so that it must write some back while they are
+   open. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 100000
+static char buf_a[FILE_SIZE];
+static char buf_b[FILE_SIZE];
+
+/* Appends the bytes of BUF from *OFS up to END to FILE_NAME,
+   open as FD, in pieces of varying size. */
+static void
+append (const char *file_name, int fd, const char *buf, size_t *ofs,
+        size_t end) 
+{
+  size_t block_size = *ofs * 37 % 300 + 1;
+  int ret_val;
+
+  if (*ofs >= end)
+    return;
+  if (block_size > end - *ofs)
+    block_size = end - *ofs;
+  ret_val = write (fd, buf + *ofs, block_size);
+  if (ret_val != (int) block_size)
+    fail ("write %zu bytes at offset %zu in \"%s\" returned %d",
+          block_size, *ofs, file_name, ret_val);
+  *ofs += block_size;
+}
+
+/* Appends to "a" and "b" up to offset END. */
+static void
+append_both (size_t *ofs_a, size_t *ofs_b, size_t end) 
+{
+  int fd_a, fd_b;
+
+  CHECK ((fd_a = open ("a")) > 1, "open \"a\"");
+  CHECK ((fd_b = open ("b")) > 1, "open \"b\"");
+  seek (fd_a, *ofs_a);
+  seek (fd_b, *ofs_b);
+
+  msg ("append to \"a\" and \"b\" up to offset %zu", end);
+  while (*ofs_a < end || *ofs_b < end) 
+    {
+      append ("a", fd_a, buf_a, ofs_a, end);
+      append ("b", fd_b, buf_b, ofs_b, end);
+    }
+
+  msg ("close \"a\"");
+  close (fd_a);
+  msg ("close \"b\"");
+  close (fd_b);
+}
+
+void
+test_main (void) 
+{
+  size_t ofs_a = 0, ofs_b = 0;
+
+  random_init (0);
+  random_bytes (buf_a, sizeof buf_a);
+  random_bytes (buf_b, sizeof buf_b);
+
+  CHECK (create ("a", 0), "create \"a\"");
+  CHECK (create ("b", 0), "create \"b\"");
+
+  append_both (&ofs_a, &ofs_b, FILE_SIZE / 2);
+  check_file ("a", buf_a, FILE_SIZE / 2);
+  check_file ("b", buf_b, FILE_SIZE / 2);
+
+  append_both (&ofs_a, &ofs_b, FILE_SIZE);
+  check_file ("a", buf_a, FILE_SIZE);
+  check_file ("b", buf_b, FILE_SIZE);
+}
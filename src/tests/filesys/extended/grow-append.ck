@@ -0,0 +1,33 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-append) begin
+(grow-append) create "a"
+(grow-append) create "b"
+(grow-append) open "a"
+(grow-append) open "b"
+(grow-append) append to "a" and "b" up to offset 50000
+(grow-append) close "a"
+(grow-append) close "b"
+(grow-append) open "a" for verification
+(grow-append) verified contents of "a"
+(grow-append) close "a"
+(grow-append) open "b" for verification
+(grow-append) verified contents of "b"
+(grow-append) close "b"
+(grow-append) open "a"
+(grow-append) open "b"
+(grow-append) append to "a" and "b" up to offset 100000
+(grow-append) close "a"
+(grow-append) close "b"
+(grow-append) open "a" for verification
+(grow-append) verified contents of "a"
+(grow-append) close "a"
+(grow-append) open "b" for verification
+(grow-append) verified contents of "b"
+(grow-append) close "b"
+(grow-append) end
+EOF
+pass;
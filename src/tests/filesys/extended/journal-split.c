@@ -0,0 +1,44 @@
+/* Creates a file so large that allocating its sectors, and later
+   freeing them, changes more of the free map than one journal
+   transaction can hold, so that the journal must commit each of
+   these operations in pieces.  Then does it again, to check that
+   all of the sectors came back, and checks that a small file
+   written afterward survives. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Spans more free map groups than one journal transaction can
+   update. */
+#define BIG_SIZE (66 * 1024 * 1024)
+
+#define SMALL_SIZE 5000
+static char buf[SMALL_SIZE];
+
+void
+test_main (void) 
+{
+  int fd;
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+
+  CHECK (create ("big", BIG_SIZE), "create \"big\"");
+  CHECK ((fd = open ("big")) > 1, "open \"big\"");
+  CHECK (filesize (fd) == BIG_SIZE, "size of \"big\" is %d", BIG_SIZE);
+  msg ("close \"big\"");
+  close (fd);
+  CHECK (remove ("big"), "remove \"big\"");
+
+  CHECK (create ("big", BIG_SIZE), "create \"big\" again");
+  CHECK (remove ("big"), "remove \"big\" again");
+
+  CHECK (create ("small", 0), "create \"small\"");
+  CHECK ((fd = open ("small")) > 1, "open \"small\"");
+  CHECK (write (fd, buf, SMALL_SIZE) == SMALL_SIZE, "write \"small\"");
+  msg ("close \"small\"");
+  close (fd);
+  check_file ("small", buf, SMALL_SIZE);
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(journal-split) begin
+(journal-split) create "big"
+(journal-split) open "big"
+(journal-split) size of "big" is 69206016
+(journal-split) close "big"
+(journal-split) remove "big"
+(journal-split) create "big" again
+(journal-split) remove "big" again
+(journal-split) create "small"
+(journal-split) open "small"
+(journal-split) write "small"
+(journal-split) close "small"
+(journal-split) open "small" for verification
+(journal-split) verified contents of "small"
+(journal-split) close "small"
+(journal-split) end
+EOF
+pass;
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my (%files);
+foreach my $name ((map ("f$_", grep ($_ % 2 == 0, 0...149))),
+                  (map ("g$_", 0...49))) {
+    $files{$name} = [substr ($name x 600, 0, 600)];
+}
+check_archive (\%files);
+pass;
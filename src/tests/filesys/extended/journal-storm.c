@@ -0,0 +1,104 @@
+/* Creates many small files, removes every other one, and creates
+   some more, then checks the files that remain.  Each of these
+   operations changes a few metadata sectors, so together they
+   fill many journal transactions and wrap around the log many
+   times. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FIRST_CNT 150           /* Files created at first. */
+#define SECOND_CNT 50           /* Files created after removing. */
+#define FILE_SIZE 600           /* Bytes in each file. */
+
+static char buf[FILE_SIZE];
+
+/* Stores the name of file number IDX with the given PREFIX into
+   NAME, and the file's contents, its name over and over, into
+   buf. */
+static void
+make_file_data (char name[16], char prefix, int idx) 
+{
+  size_t i;
+
+  snprintf (name, 16, "%c%d", prefix, idx);
+  for (i = 0; i < FILE_SIZE; i++)
+    buf[i] = name[i % strlen (name)];
+}
+
+/* Creates file number IDX with the given PREFIX. */
+static void
+create_file (char prefix, int idx) 
+{
+  char name[16];
+  int fd;
+
+  make_file_data (name, prefix, idx);
+  if (!create (name, 0))
+    fail ("create \"%s\" failed", name);
+  fd = open (name);
+  if (fd < 2)
+    fail ("open \"%s\" failed", name);
+  if (write (fd, buf, FILE_SIZE) != FILE_SIZE)
+    fail ("write \"%s\" failed", name);
+  close (fd);
+}
+
+/* Checks the contents of file number IDX with the given
+   PREFIX. */
+static void
+verify_file (char prefix, int idx) 
+{
+  static char data[FILE_SIZE];
+  char name[16];
+  int fd;
+
+  make_file_data (name, prefix, idx);
+  fd = open (name);
+  if (fd < 2)
+    fail ("open \"%s\" failed", name);
+  if (filesize (fd) != FILE_SIZE
+      || read (fd, data, FILE_SIZE) != FILE_SIZE
+      || memcmp (data, buf, FILE_SIZE))
+    fail ("\"%s\" has the wrong contents", name);
+  close (fd);
+}
+
+void
+test_main (void) 
+{
+  char name[16];
+  int i;
+
+  msg ("create %d files", FIRST_CNT);
+  for (i = 0; i < FIRST_CNT; i++)
+    create_file ('f', i);
+
+  msg ("remove every other file");
+  for (i = 1; i < FIRST_CNT; i += 2) 
+    {
+      snprintf (name, sizeof name, "f%d", i);
+      if (!remove (name))
+        fail ("remove \"%s\" failed", name);
+    }
+
+  msg ("create %d more files", SECOND_CNT);
+  for (i = 0; i < SECOND_CNT; i++)
+    create_file ('g', i);
+
+  msg ("check the remaining files");
+  for (i = 0; i < FIRST_CNT; i++)
+    if (i % 2 == 0)
+      verify_file ('f', i);
+    else 
+      {
+        snprintf (name, sizeof name, "f%d", i);
+        if (open (name) != -1)
+          fail ("removed file \"%s\" can still be opened", name);
+      }
+  for (i = 0; i < SECOND_CNT; i++)
+    verify_file ('g', i);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(journal-storm) begin
+(journal-storm) create 150 files
+(journal-storm) remove every other file
+(journal-storm) create 50 more files
+(journal-storm) check the remaining files
+(journal-storm) end
+EOF
+pass;
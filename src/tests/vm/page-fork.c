@@ -0,0 +1,61 @@
+/* Fills a page and then 2 MB of memory, so that much of the 2 MB
+   is swapped out while the page stays in memory, and forks.  The
+   child overwrites both and checks its own view.  The parent
+   then checks that its copies are unchanged, so that neither a
+   frame nor a swap slot was still shared with the child once the
+   child wrote to it. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 1024 * 1024)
+
+static char big[SIZE];
+static char small[4096];
+
+/* Fails unless all SIZE bytes of BUF, called NAME, are VALUE. */
+static void
+check (const char *name, const char *buf, size_t size, char value)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (buf[i] != value)
+      fail ("%s: byte %zu is 0x%02x, expected 0x%02x",
+            name, i, buf[i] & 0xff, value & 0xff);
+}
+
+void
+test_main (void)
+{
+  pid_t child;
+  int status;
+
+  msg ("initialize");
+  memset (big, 0x5a, sizeof big);
+  memset (small, 0x5a, sizeof small);
+
+  msg ("fork");
+  child = fork ();
+  if (child == 0)
+    {
+      msg ("child: overwrite");
+      memset (small, 0xa5, sizeof small);
+      memset (big, 0xa5, sizeof big);
+      check ("child's small", small, sizeof small, 0xa5);
+      check ("child's big", big, sizeof big, 0xa5);
+      msg ("child: done");
+      exit (81);
+    }
+  if (child < 0)
+    fail ("fork failed");
+
+  status = wait (child);
+  if (status != 81)
+    fail ("wait for child returned %d, expected 81", status);
+  msg ("check parent's memory");
+  check ("parent's small", small, sizeof small, 0x5a);
+  check ("parent's big", big, sizeof big, 0x5a);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-fork) begin
+(page-fork) initialize
+(page-fork) fork
+(page-fork) child: overwrite
+(page-fork) child: done
+(page-fork) check parent's memory
+(page-fork) end
+EOF
+pass;
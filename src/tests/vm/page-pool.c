@@ -0,0 +1,78 @@
+/* Fills 2 MB of memory with pages that compress well, which
+   swap keeps compressed in memory, interleaved with pages that do
+   not compress, which swap writes to disk.  Then checks every
+   page, swaps the two kinds around, and checks every page
+   again. */
+
+#include <string.h>
+#include "tests/arc4.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 512
+
+static char buf[PAGE_CNT][PAGE_SIZE];
+static char expected[PAGE_SIZE];
+
+/* Stores into EXPECTED the contents of page IDX in the pass
+   PASS: if IDX + PASS is even, the page's number over and over,
+   which compresses well, otherwise bytes from a key stream
+   seeded with the page's number, which do not. */
+static void
+make_page (int idx, int pass) 
+{
+  if ((idx + pass) % 2 == 0)
+    {
+      size_t i;
+
+      for (i = 0; i < PAGE_SIZE; i += sizeof idx)
+        memcpy (expected + i, &idx, sizeof idx);
+    }
+  else
+    {
+      struct arc4 arc4;
+
+      arc4_init (&arc4, &idx, sizeof idx);
+      memset (expected, 0, PAGE_SIZE);
+      arc4_crypt (&arc4, expected, PAGE_SIZE);
+    }
+}
+
+/* Writes the contents of every page for pass PASS. */
+static void
+write_pages (int pass) 
+{
+  int i;
+
+  msg ("write pass %d", pass);
+  for (i = 0; i < PAGE_CNT; i++) 
+    {
+      make_page (i, pass);
+      memcpy (buf[i], expected, PAGE_SIZE);
+    }
+}
+
+/* Checks the contents of every page for pass PASS. */
+static void
+check_pages (int pass) 
+{
+  int i;
+
+  msg ("check pass %d", pass);
+  for (i = 0; i < PAGE_CNT; i++) 
+    {
+      make_page (i, pass);
+      if (memcmp (buf[i], expected, PAGE_SIZE))
+        fail ("page %d is wrong after pass %d", i, pass);
+    }
+}
+
+void
+test_main (void)
+{
+  write_pages (0);
+  check_pages (0);
+  write_pages (1);
+  check_pages (1);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-pool) begin
+(page-pool) write pass 0
+(page-pool) check pass 0
+(page-pool) write pass 1
+(page-pool) check pass 1
+(page-pool) end
+EOF
+pass;
@@ -30,10 +30,22 @@
 #else
 #include "tests/threads/tests.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#endif
 #ifdef FILESYS
 #include "devices/disk.h"
+#include "devices/iosched.h"
+#include "devices/pci.h"
+#include "devices/ramdisk.h"
+#include "devices/virtio-blk.h"
+#include "filesys/directory.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
+#include "filesys/journal.h"
+#include "filesys/tmpfs.h"
 #endif
 
 /* Amount of physical memory, in 4 kB pages. */
@@ -45,6 +57,16 @@ uint32_t *base_page_dir;
 #ifdef FILESYS
 /* -f: Format the file system? */
 static bool format_filesys;
+
+/* -ramdisk: Size of ramdisk to use as file system disk, in kB,
+   or 0 for none. */
+static size_t ramdisk_kb;
+
+/* -ramdisk-load: Preload ramdisk from scratch disk? */
+static bool ramdisk_load;
+
+/* -tmpfs: Memory cap for tmpfs, in kB, or 0 to disable tmpfs. */
+static size_t tmpfs_kb;
 #endif
 
 /* -q: Power off after kernel tasks complete? */
@@ -91,6 +113,10 @@ main (void)
   palloc_init ();
   malloc_init ();
   paging_init ();
+#ifdef VM
+  frame_init ();
+  page_init ();
+#endif
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -116,7 +142,16 @@ main (void)
 #ifdef FILESYS
   /* Initialize file system. */
   disk_init ();
+  pci_init ();
+  virtio_blk_init ();
+  if (ramdisk_kb > 0)
+    ramdisk_init (ramdisk_kb, ramdisk_load);
   filesys_init (format_filesys);
+  if (tmpfs_kb > 0)
+    tmpfs_init (tmpfs_kb);
+#endif
+#ifdef VM
+  swap_init ();
 #endif
 
   printf ("Boot complete.\n");
@@ -248,6 +283,20 @@ parse_options (char **argv)
 #ifdef FILESYS
       else if (!strcmp (name, "-f"))
         format_filesys = true;
+      else if (!strcmp (name, "-iosched"))
+        {
+          if (value == NULL || !iosched_select (value))
+            PANIC ("unknown I/O scheduler `%s' (use -h for help)",
+                   value != NULL ? value : "");
+        }
+      else if (!strcmp (name, "-ramdisk"))
+        ramdisk_kb = atoi (value);
+      else if (!strcmp (name, "-ramdisk-load"))
+        ramdisk_load = true;
+      else if (!strcmp (name, "-tmpfs"))
+        tmpfs_kb = atoi (value);
+      else if (!strcmp (name, "-compress"))
+        filesys_compress = true;
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
@@ -256,6 +305,17 @@ parse_options (char **argv)
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-stack"))
+        {
+          size_t kb = atoi (value);
+          if (kb < 4 || kb > 512 * 1024)
+            PANIC ("bad stack limit `%s' (use -h for help)", value);
+          page_stack_limit = kb * 1024;
+        }
+      else if (!strcmp (name, "-swap-pool"))
+        swap_pool_kb = atoi (value);
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -310,8 +370,10 @@ run_actions (char **argv)
       {"ls", 1, fsutil_ls},
       {"cat", 2, fsutil_cat},
       {"rm", 2, fsutil_rm},
+      {"clone", 3, fsutil_clone},
       {"extract", 1, fsutil_extract},
       {"append", 2, fsutil_append},
+      {"defrag", 1, fsutil_defrag},
 #endif
       {NULL, 0, NULL},
     };
@@ -358,19 +420,34 @@ usage (void)
           "  ls                 List files in the root directory.\n"
           "  cat FILE           Print FILE to the console.\n"
           "  rm FILE            Delete FILE.\n"
+          "  clone FILE NEW     Copy FILE to NEW, sharing its data.\n"
           "Use these actions indirectly via `pintos' -g and -p options:\n"
           "  extract            Untar from scratch disk into file system.\n"
           "  append FILE        Append FILE to tar file on scratch disk.\n"
+          "  defrag             Lay out files contiguously, in directory order.\n"
 #endif
           "\nOptions:\n"
           "  -h                 Print this help message and power off.\n"
           "  -q                 Power off VM after actions or on panic.\n"
           "  -r                 Reboot after actions.\n"
           "  -f                 Format file system disk during startup.\n"
+#ifdef FILESYS
+          "  -iosched=POLICY    Use disk I/O scheduler POLICY: fifo, clook,\n"
+          "                     or deadline (the default).\n"
+          "  -ramdisk=KB        Use a KB kB ramdisk as file system disk.\n"
+          "  -ramdisk-load      Preload the ramdisk from the scratch disk.\n"
+          "  -tmpfs=KB          Keep files named /tmp/* in up to KB kB of RAM.\n"
+          "  -compress          Compress the data of newly created files.\n"
+#endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -stack=KB          Limit process stacks to KB kB (default 8192).\n"
+          "  -swap-pool=KB      Keep up to KB kB of compressed swap in RAM\n"
+          "                     (default 256, 0 to disable).\n"
 #endif
           );
   power_off ();
@@ -443,10 +520,18 @@ print_stats (void)
   thread_print_stats ();
 #ifdef FILESYS
   disk_print_stats ();
+  journal_print_stats ();
+  tmpfs_print_stats ();
+  dir_print_stats ();
 #endif
   console_print_stats ();
   kbd_print_stats ();
 #ifdef USERPROG
   exception_print_stats ();
 #endif
+#ifdef VM
+  frame_print_stats ();
+  page_print_stats ();
+  swap_print_stats ();
+#endif
 }
@@ -4,6 +4,9 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#ifdef VM
+#include <hash.h>
+#endif
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -107,6 +110,18 @@ struct thread
     uint32_t *pagedir;                  /* Page directory. */
     struct list files;                  /* list of open files. */
     int ret_status;                     /* Return status. */
+    struct dir *cwd;                    /* Working directory, or null
+                                           for the root. */
+#endif
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash *pages;                 /* Supplemental page table. */
+    struct file *exec_file;             /* Executable, for paging. */
+    struct list mappings;               /* Memory-mapped files. */
+    int next_mapid;                     /* Next mapping identifier. */
+    size_t stack_limit;                 /* Maximum stack size, in bytes. */
+    void *user_esp;                     /* User stack pointer on entry
+                                           to the kernel. */
 #endif
 
     /* Owned by thread.c. */
@@ -4,6 +4,10 @@
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -148,9 +152,20 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
-  /* To implement virtual memory, delete the rest of the function
-     body, and replace it with code that brings in the page to
-     which fault_addr refers. */
+#ifdef VM
+  /* Remember the user stack pointer, by which the stack grows. */
+  if (user)
+    thread_current ()->user_esp = f->esp;
+
+  /* Bring in the page that FAULT_ADDR refers to, if the process
+     has one there, or give it a copy of a page it shares
+     copy-on-write if it wrote to one.  This also covers kernel
+     accesses to user memory during system calls. */
+  if ((not_present || write) && is_user_vaddr (fault_addr)
+      && page_in (fault_addr, write))
+    return;
+#endif
+
   printf ("Page fault at %p: %s error %s page in %s context.\n",
           fault_addr,
           not_present ? "not present" : "rights violation",
@@ -16,10 +16,19 @@
 #include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "userprog/syscall.h"
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 static thread_func start_process NO_RETURN;
+#ifdef VM
+static thread_func start_fork NO_RETURN;
+#endif
 static bool load (const char *cmdline, void (**eip) (void), void **esp,
                   char **arg);
 /* void test_stack (int *t); */
@@ -27,6 +36,13 @@ static bool load (const char *cmdline, void (**eip) (void), void **esp,
 #define DEFAULT_ARGV 2
 #define WORD_SIZE 4
 
+/* What process_execute() passes to start_process(), in a page. */
+struct exec_info
+  {
+    struct dir *cwd;                    /* Working directory to inherit. */
+    char cmd_line[PGSIZE - sizeof (struct dir *)];      /* Command line. */
+  };
+
 /* Starts a new thread running a user program loaded from
    FILENAME.  The new thread may be scheduled (and may even exit)
    before process_execute() returns.  Returns the new process's
@@ -34,29 +50,37 @@ static bool load (const char *cmdline, void (**eip) (void), void **esp,
 tid_t
 process_execute (const char *file_name) 
 {
-  char *fn_copy;
+  struct thread *cur = thread_current ();
+  struct exec_info *info;
   tid_t tid;
 
   /* Make a copy of FILE_NAME.
-     Otherwise there's a race between the caller and load(). */
-  fn_copy = palloc_get_page (0);
-  if (fn_copy == NULL)
+     Otherwise there's a race between the caller and load().
+     The new process starts out in the caller's working
+     directory. */
+  info = palloc_get_page (0);
+  if (info == NULL)
     return TID_ERROR;
-  strlcpy (fn_copy, file_name, PGSIZE);
+  strlcpy (info->cmd_line, file_name, sizeof info->cmd_line);
+  info->cwd = cur->cwd != NULL ? dir_reopen (cur->cwd) : NULL;
 
   /* Create a new thread to execute FILE_NAME. */
-  tid = thread_create (file_name, PRI_DEFAULT, start_process, fn_copy);
+  tid = thread_create (file_name, PRI_DEFAULT, start_process, info);
   if (tid == TID_ERROR)
-    palloc_free_page (fn_copy); 
+    {
+      dir_close (info->cwd);
+      palloc_free_page (info); 
+    }
   return tid;
 }
 
 /* A thread function that loads a user process and starts it
    running. */
 static void
-start_process (void *file_name_)
+start_process (void *info_)
 {
-  char *file_name = file_name_;
+  struct exec_info *info = info_;
+  char *file_name;
   struct intr_frame if_;
   bool success;
   char *save_ptr;
@@ -64,17 +88,23 @@ start_process (void *file_name_)
   /* Get the name of the userprog needed to be run. 
    * save_ptr is pointer to arguments to that userprog.
    */
-  file_name = strtok_r(file_name, " ", &save_ptr);
+  thread_current ()->cwd = info->cwd;
+  file_name = strtok_r(info->cmd_line, " ", &save_ptr);
 
   /* Initialize interrupt frame and load executable. */
   memset (&if_, 0, sizeof if_);
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
+#ifdef VM
+  success = (page_table_init ()
+             && load (file_name, &if_.eip, &if_.esp, &save_ptr));
+#else
   success = load (file_name, &if_.eip, &if_.esp, &save_ptr);
+#endif
 
   /* If load failed, quit. */
-  palloc_free_page (file_name);
+  palloc_free_page (info);
   if (!success) 
     thread_exit ();
 
@@ -88,6 +118,89 @@ start_process (void *file_name_)
   NOT_REACHED ();
 }
 
+#ifdef VM
+/* What process_fork() passes to start_fork(). */
+struct fork_info
+  {
+    struct intr_frame if_;              /* Parent's user registers. */
+    struct thread *parent;              /* Parent thread. */
+    struct semaphore done;              /* Upped when the copy is done. */
+    bool success;                       /* Copied successfully? */
+  };
+
+/* Starts a new process that is a copy of the running one, which
+   is in the system call whose interrupt frame is IF_.  The child
+   shares the parent's memory copy-on-write and has copies of its
+   open files and memory mappings; it starts out returning 0 from
+   the system call.  Returns the child's thread id, or TID_ERROR
+   if the child cannot be created. */
+tid_t
+process_fork (const struct intr_frame *if_)
+{
+  struct fork_info info;
+  tid_t tid;
+
+  info.if_ = *if_;
+  info.parent = thread_current ();
+  sema_init (&info.done, 0);
+  info.success = false;
+
+  /* The parent waits, so that its memory and files stay put
+     while the child copies them. */
+  tid = thread_create (thread_name (), PRI_DEFAULT, start_fork, &info);
+  if (tid == TID_ERROR)
+    return TID_ERROR;
+  sema_down (&info.done);
+  return info.success ? tid : TID_ERROR;
+}
+
+/* A thread function that copies the parent process described by
+   INFO_ and starts it running. */
+static void
+start_fork (void *info_)
+{
+  struct fork_info *info = info_;
+  struct thread *t = thread_current ();
+  struct thread *parent = info->parent;
+  struct intr_frame if_ = info->if_;
+  bool success = false;
+  bool locked;
+
+  t->pagedir = pagedir_create ();
+  if (t->pagedir == NULL)
+    goto done;
+  process_activate ();
+
+  locked = syscall_acquire_filesys ();
+  t->cwd = parent->cwd != NULL ? dir_reopen (parent->cwd) : NULL;
+  if (parent->exec_file != NULL)
+    t->exec_file = file_reopen (parent->exec_file);
+  syscall_release_filesys (locked);
+  if (parent->exec_file != NULL && t->exec_file == NULL)
+    goto done;
+
+  success = page_table_init ();
+  t->stack_limit = parent->stack_limit;
+  success = (success
+             && mmap_copy (parent)
+             && page_table_copy (parent)
+             && syscall_copy_files (parent));
+
+ done:
+  /* INFO lives on the parent's stack, so it may be gone once the
+     parent wakes up. */
+  info->success = success;
+  sema_up (&info->done);
+  if (!success)
+    thread_exit ();
+
+  /* Return 0 from fork() in the child. */
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+#endif
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -117,6 +230,21 @@ process_exit (void)
   struct thread *cur = thread_current ();
   uint32_t *pd;
 
+#ifdef VM
+  /* Unmap files, then forget the process's pages and the
+     executable they were read from. */
+  if (cur->pages != NULL)
+    mmap_unmap_all ();
+  page_table_destroy ();
+  if (cur->exec_file != NULL)
+    {
+      bool locked = syscall_acquire_filesys ();
+      file_close (cur->exec_file);
+      syscall_release_filesys (locked);
+      cur->exec_file = NULL;
+    }
+#endif
+
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = cur->pagedir;
@@ -133,6 +261,9 @@ process_exit (void)
       pagedir_activate (NULL);
       pagedir_destroy (pd);
     }
+
+  dir_close (cur->cwd);
+  cur->cwd = NULL;
 }
 
 /* Sets up the CPU for running user code in the current
@@ -344,13 +475,24 @@ load (const char *file_name, void (**eip) (void), void **esp, char **arg)
 
  done:
   /* We arrive here whether the load is successful or not. */
+#ifdef VM
+  /* The executable's pages are read in on demand, so keep it open
+     while the process runs. */
+  if (success)
+    t->exec_file = file;
+  else
+    file_close (file);
+#else
   file_close (file);
+#endif
   return success;
 }
 
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -409,6 +551,9 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With virtual memory, the pages are only recorded in the
+   supplemental page table here, and read in when first touched.
+
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
 static bool
@@ -428,6 +573,17 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
+#ifdef VM
+      /* Record where the page comes from; it is read in when the
+         process first touches it.  Every process running the
+         executable shares one frame for each read-only page read
+         from it, such as code. */
+      if (!page_add (upage, page_read_bytes > 0 ? file : NULL, ofs,
+                     page_read_bytes, writable,
+                     !writable && page_read_bytes > 0))
+        return false;
+      ofs += page_read_bytes;
+#else
       /* Get a page of memory. */
       uint8_t *kpage = palloc_get_page (PAL_USER);
       if (kpage == NULL)
@@ -447,6 +603,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
           palloc_free_page (kpage);
           return false; 
         }
+#endif
 
       /* Advance. */
       read_bytes -= page_read_bytes;
@@ -461,13 +618,24 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 static bool
 setup_stack (void **esp, const char *file_name, char** arg) 
 {
+  uint8_t *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
+#ifndef VM
   uint8_t *kpage;
+#endif
   bool success = false;
 
+#ifdef VM
+  if (page_add (upage, NULL, 0, 0, true, false))
+#else
   kpage = palloc_get_page (PAL_USER | PAL_ZERO);
   if (kpage != NULL) 
+#endif
     {
-      success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
+#ifdef VM
+      success = page_in (upage, true);
+#else
+      success = install_page (upage, kpage, true);
+#endif
       if (success)
         {
           *esp = PHYS_BASE;
@@ -523,14 +691,17 @@ setup_stack (void **esp, const char *file_name, char** arg)
           /* Free the space alloted to argv. */ 
           free(argv);
         }
+#ifndef VM
       else
       {
         palloc_free_page (kpage);
       } 
+#endif
     }
   return success;
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -550,3 +721,4 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif
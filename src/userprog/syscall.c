@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <syscall-nr.h>
+#include <dirent.h>
 #include <inttypes.h>
 #include <list.h>
 // #include <console.h>
@@ -19,11 +20,17 @@
 // #include "devices/kbd.h"
 // #include "devices/serial.h"
 
+#include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 
 #include "userprog/syscall.h"
 #include "userprog/process.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 typedef int pid_t;
 typedef int fid_t;
@@ -43,9 +50,20 @@ static 	int 	syscall_write (int, const void *, unsigned);
 static 	void 	syscall_seek (int, unsigned);
 static 	unsigned syscall_tell (int);
 static 	void 	syscall_close (int);
+#ifdef VM
+static 	int 	syscall_mmap (int, void *);
+static 	void 	syscall_munmap (int);
+#endif
+static 	bool 	syscall_clone (const char *, const char *);
+static 	bool 	syscall_chdir (const char *);
+static 	bool 	syscall_mkdir (const char *);
+static 	bool 	syscall_readdir (int, char *);
+static 	bool 	syscall_isdir (int);
+static 	int 	syscall_inumber (int);
+static 	int 	syscall_readdir_plus (int, struct dirent *, int);
 
 typedef int (*syscall_t) (uint32_t, uint32_t, uint32_t);
-static syscall_t syscall_function[32];
+static syscall_t syscall_function[SYS_CNT];
 
 // static void * esp_;
 
@@ -57,9 +75,12 @@ struct userFile_t {
 	fid_t fid;
 	struct list_elem threadElement;
 	struct file *f;
+	struct dir *dir;	// Non-null if f is a directory.
 };
 
 static bool validateUser (const int *);
+static void validateString (const char *);
+static char *copyInString (const char *);
 static struct userFile_t *fileFromFid (fid_t);
 static fid_t allocateFid (void);
 static void print_stats (void);
@@ -84,9 +105,84 @@ syscall_init (void) {
 	syscall_function[SYS_SEEK]     = (syscall_t) syscall_seek;
 	syscall_function[SYS_TELL]     = (syscall_t) syscall_tell;
 	syscall_function[SYS_CLOSE]    = (syscall_t) syscall_close;
+#ifdef VM
+	syscall_function[SYS_MMAP]     = (syscall_t) syscall_mmap;
+	syscall_function[SYS_MUNMAP]   = (syscall_t) syscall_munmap;
+#endif
+	syscall_function[SYS_CHDIR]    = (syscall_t) syscall_chdir;
+	syscall_function[SYS_MKDIR]    = (syscall_t) syscall_mkdir;
+	syscall_function[SYS_READDIR]  = (syscall_t) syscall_readdir;
+	syscall_function[SYS_ISDIR]    = (syscall_t) syscall_isdir;
+	syscall_function[SYS_INUMBER]  = (syscall_t) syscall_inumber;
+	syscall_function[SYS_CLONE]    = (syscall_t) syscall_clone;
+	syscall_function[SYS_READDIR_PLUS] = (syscall_t) syscall_readdir_plus;
 
 }
 
+/* Acquires the file system lock, unless the running thread
+   already holds it, as when a system call faults on a user page
+   that must be read from a file.  Returns true if it acquired the
+   lock, which the caller passes to syscall_release_filesys(). */
+bool
+syscall_acquire_filesys (void) {
+	if (lock_held_by_current_thread (&fileLock))
+		return false;
+	lock_acquire (&fileLock);
+	return true;
+}
+
+/* Releases the file system lock if ACQUIRED is true. */
+void
+syscall_release_filesys (bool acquired) {
+	if (acquired)
+		lock_release (&fileLock);
+}
+
+#ifdef VM
+/* Gives the running thread a copy of each of PARENT's open files,
+   with the same descriptors and positions, for fork().  PARENT
+   must not run meanwhile.  Returns true if successful.  On
+   failure, closes the copies made so far and returns false. */
+bool
+syscall_copy_files (struct thread *parent) {
+	struct thread *th = thread_current ();
+	struct list_elem *it;
+	bool success = true;
+
+	lock_acquire (&fileLock);
+	for (it = list_begin (&parent->files); it != list_end (&parent->files);
+		it = list_next (it))
+	{
+		struct userFile_t *from = list_entry (it, struct userFile_t, threadElement);
+		struct userFile_t *userFile = malloc (sizeof (struct userFile_t));
+
+		if (userFile == NULL) {
+			success = false;
+			break;
+		}
+		userFile->fid = from->fid;
+		userFile->f = file_reopen (from->f);
+		userFile->dir = from->dir != NULL ? dir_reopen (from->dir) : NULL;
+		if (userFile->f == NULL || (from->dir != NULL && userFile->dir == NULL)) {
+			dir_close (userFile->dir);
+			file_close (userFile->f);
+			free (userFile);
+			success = false;
+			break;
+		}
+		file_seek (userFile->f, file_tell (from->f));
+		list_push_back (&th->files, &userFile->threadElement);
+	}
+	lock_release (&fileLock);
+
+	if (!success)
+		while (!list_empty (&th->files))
+			syscall_close (list_entry (list_begin (&th->files), struct userFile_t,
+				threadElement)->fid);
+	return success;
+}
+#endif
+
 static void
 syscall_handler (struct intr_frame *f) {
 	syscall_t func;
@@ -95,10 +191,23 @@ syscall_handler (struct intr_frame *f) {
 	if ( !validateUser (param) )
 		syscall_exit (-1);
 
+#ifdef VM
+	// Page faults in the kernel grow the stack by the user's esp.
+	thread_current ()->user_esp = f->esp;
+#endif
+
 	if (!( validateUser (param + 1) && validateUser (param + 2) && validateUser (param + 3)))
 		syscall_exit (-1);
 
-	if (*param < SYS_HALT || *param > SYS_INUMBER)
+#ifdef VM
+	// fork needs the caller's registers, not just its arguments.
+	if (*param == SYS_FORK) {
+		f->eax = process_fork (f);
+		return;
+	}
+#endif
+
+	if (*param < SYS_HALT || *param >= SYS_CNT || syscall_function[*param] == NULL)
 		syscall_exit (-1);
 
 	func = syscall_function[*param];
@@ -147,9 +256,14 @@ syscall_exit (int status) {
 
 static pid_t
 syscall_exec (const char *cmd_line) {
+	char *kcmd_line = copyInString (cmd_line);
+	if (kcmd_line == NULL)
+		return -1;
+
 	lock_acquire (&fileLock);
-	int returnValue = process_execute (cmd_line);
+	int returnValue = process_execute (kcmd_line);
 	lock_release (&fileLock);
+	palloc_free_page (kcmd_line);
 	return returnValue;
 }
 
@@ -162,10 +276,15 @@ static bool
 syscall_create (const char *file, unsigned initial_size) {
 	if (file == NULL) 
 		syscall_exit (-1);
+
+	char *kfile = copyInString (file);
+	if (kfile == NULL)
+		return false;
 	
 	lock_acquire (&fileLock);
-	int returnValue = filesys_create (file, initial_size);
+	int returnValue = filesys_create (kfile, initial_size);
 	lock_release (&fileLock);
+	palloc_free_page (kfile);
 	return returnValue;
 }
 
@@ -173,10 +292,15 @@ static bool
 syscall_remove (const char *file) {
 	if (file == NULL) 
 		syscall_exit (-1);
+
+	char *kfile = copyInString (file);
+	if (kfile == NULL)
+		return false;
 	
 	lock_acquire (&fileLock);
-	bool returnValue = filesys_remove (file);
+	bool returnValue = filesys_remove (kfile);
 	lock_release (&fileLock);
+	palloc_free_page (kfile);
 	return returnValue;
 }
 
@@ -187,10 +311,15 @@ syscall_open (const char *file) {
 	
 	struct file *openFile;
 	struct userFile_t *userFile;
+	char *kfile = copyInString (file);
+
+	if (kfile == NULL)
+		return -1;
 
 	lock_acquire (&fileLock);
-	openFile = filesys_open (file);
+	openFile = filesys_open (kfile);
 	lock_release (&fileLock);
+	palloc_free_page (kfile);
 
 	if (openFile == NULL) 
 		return -1;
@@ -205,6 +334,9 @@ syscall_open (const char *file) {
 	list_push_back (&thread_current ()->files, &userFile->threadElement);
 	userFile->fid = allocateFid ();
 	userFile->f = openFile;
+	userFile->dir = NULL;
+	if (inode_is_dir (file_get_inode (openFile)))
+		userFile->dir = dir_open (inode_reopen (file_get_inode (openFile)));
 	lock_release (&fileLock);
 
 	return userFile->fid;	
@@ -234,14 +366,22 @@ syscall_read (int fd, void *buffer, unsigned size) {
 
 	if (!validateUser (buffer) || !validateUser (buffer + size)) {
 		syscall_exit (-1);
-	} else if (fd == STDIN_FILENO){
+	}
+	if (fd == STDIN_FILENO){
 		unsigned i = 0;
 
+#ifdef VM
+		if (!page_lock (buffer, size, true))
+			syscall_exit (-1);
+#endif
 		lock_acquire (&fileLock);
 		for( ; i < size; i++){
 			((uint8_t *)buffer)[i] = input_getc();
 		}
 		lock_release (&fileLock);
+#ifdef VM
+		page_unlock (buffer, size);
+#endif
 
 		returnValue = size;
 	} else if(fd == STDOUT_FILENO) {
@@ -250,10 +390,22 @@ syscall_read (int fd, void *buffer, unsigned size) {
 		userFile = fileFromFid (fd);
 		if (userFile == NULL) 
 			syscall_exit (-1);
+		if (userFile->dir != NULL)
+			return -1;
+#ifdef VM
+		// Bring the buffer in and keep it there until the read is done,
+		// so that the file system doesn't fault on it halfway through,
+		// with its locks held.
+		if (!page_lock (buffer, size, true))
+			syscall_exit (-1);
+#endif
 
 		lock_acquire (&fileLock);
 		returnValue = file_read (userFile->f, buffer, size);
 		lock_release (&fileLock);
+#ifdef VM
+		page_unlock (buffer, size);
+#endif
 	}
 	return returnValue;
 }
@@ -274,13 +426,20 @@ syscall_write (int fd, const void *buffer, unsigned size) {
 		syscall_exit (-1);
 	} else {
 		userFile = fileFromFid (fd);
-		if (userFile == NULL)
+		if (userFile == NULL || userFile->dir != NULL)
 			returnValue = -1;
 		else {
+#ifdef VM
+			if (!page_lock (buffer, size, false))
+				syscall_exit (-1);
+#endif
 
 			lock_acquire (&fileLock);
 			returnValue = file_write (userFile->f, buffer, size);
 			lock_release (&fileLock);  
+#ifdef VM
+			page_unlock (buffer, size);
+#endif
 		}
 	}
 	return returnValue;
@@ -325,16 +484,209 @@ syscall_close (int fd) {
 
 	lock_acquire (&fileLock);
 	list_remove (&userFile->threadElement);
+	dir_close (userFile->dir);
 	file_close (userFile->f);
 	free (userFile);
 	lock_release (&fileLock);
 }
 
+#ifdef VM
+static int
+syscall_mmap (int fd, void *addr) {
+	struct userFile_t *userFile;
+	int mapid;
+
+	userFile = fileFromFid (fd);
+	if (userFile == NULL || userFile->dir != NULL)
+		return -1;
+
+	lock_acquire (&fileLock);
+	mapid = mmap_map (userFile->f, addr);
+	lock_release (&fileLock);
+	return mapid;
+}
+
+static void
+syscall_munmap (int mapid) {
+	// Writing back modified pages takes the file lock as needed.
+	mmap_unmap (mapid);
+}
+#endif
+
+static bool
+syscall_clone (const char *file, const char *newFile) {
+	if (file == NULL || newFile == NULL)
+		syscall_exit (-1);
+	validateString (file);
+	validateString (newFile);
+
+	char *kfile = copyInString (file);
+	char *knewFile = copyInString (newFile);
+	bool returnValue = false;
+
+	if (kfile != NULL && knewFile != NULL) {
+		lock_acquire (&fileLock);
+		returnValue = filesys_clone (kfile, knewFile);
+		lock_release (&fileLock);
+	}
+	if (kfile != NULL)
+		palloc_free_page (kfile);
+	if (knewFile != NULL)
+		palloc_free_page (knewFile);
+	return returnValue;
+}
+
+static bool
+syscall_chdir (const char *dir) {
+	if (dir == NULL)
+		syscall_exit (-1);
+
+	char *kdir = copyInString (dir);
+	if (kdir == NULL)
+		return false;
+
+	lock_acquire (&fileLock);
+	bool returnValue = filesys_chdir (kdir);
+	lock_release (&fileLock);
+	palloc_free_page (kdir);
+	return returnValue;
+}
+
+static bool
+syscall_mkdir (const char *dir) {
+	if (dir == NULL)
+		syscall_exit (-1);
+
+	char *kdir = copyInString (dir);
+	if (kdir == NULL)
+		return false;
+
+	lock_acquire (&fileLock);
+	bool returnValue = filesys_mkdir (kdir);
+	lock_release (&fileLock);
+	palloc_free_page (kdir);
+	return returnValue;
+}
+
+static bool
+syscall_readdir (int fd, char *name) {
+	struct userFile_t *userFile;
+	bool returnValue;
+
+	if (!validateUser ((const int *) name) || !validateUser ((const int *) (name + NAME_MAX)))
+		syscall_exit (-1);
+
+	userFile = fileFromFid (fd);
+	if (userFile == NULL || userFile->dir == NULL)
+		return false;
+#ifdef VM
+	if (!page_lock (name, NAME_MAX + 1, true))
+		syscall_exit (-1);
+#endif
+
+	lock_acquire (&fileLock);
+	returnValue = dir_readdir (userFile->dir, name);
+	lock_release (&fileLock);
+#ifdef VM
+	page_unlock (name, NAME_MAX + 1);
+#endif
+	return returnValue;
+}
+
+static bool
+syscall_isdir (int fd) {
+	struct userFile_t *userFile;
+
+	userFile = fileFromFid (fd);
+	if (userFile == NULL)
+		syscall_exit (-1);
+
+	return userFile->dir != NULL;
+}
+
+static int
+syscall_inumber (int fd) {
+	struct userFile_t *userFile;
+
+	userFile = fileFromFid (fd);
+	if (userFile == NULL)
+		syscall_exit (-1);
+
+	return inode_get_inumber (file_get_inode (userFile->f));
+}
+
+static int
+syscall_readdir_plus (int fd, struct dirent *entries, int cnt) {
+	struct userFile_t *userFile;
+	int returnValue;
+
+	if (cnt < 0 || (unsigned) cnt > (unsigned) PHYS_BASE / sizeof *entries
+			|| !validateUser ((const int *) entries) || !validateUser ((const int *) (entries + cnt)))
+		syscall_exit (-1);
+
+	userFile = fileFromFid (fd);
+	if (userFile == NULL || userFile->dir == NULL)
+		return -1;
+#ifdef VM
+	if (!page_lock (entries, cnt * sizeof *entries, true))
+		syscall_exit (-1);
+#endif
+
+	lock_acquire (&fileLock);
+	returnValue = dir_readdir_plus (userFile->dir, entries, cnt);
+	lock_release (&fileLock);
+#ifdef VM
+	page_unlock (entries, cnt * sizeof *entries);
+#endif
+	return returnValue;
+}
+
 static bool
 validateUser (const int *address) {
 	return address < PHYS_BASE;
 }
 
+// Exits the process if the user string USTR runs out of user memory
+// within its first page's worth of bytes.  Holds nothing that exiting
+// would leak, so a system call that copies in several strings checks
+// them all before copying any.
+static void
+validateString (const char *ustr) {
+	size_t i;
+
+	for (i = 0; i < PGSIZE; i++) {
+		if (!validateUser ((const int *) (ustr + i)))
+			syscall_exit (-1);
+		if (ustr[i] == '\0')
+			return;
+	}
+}
+
+// Copies the user string USTR into a new page of kernel memory, so
+// that the file system, which runs with fileLock held, never has to
+// fault in the user's pages.  Returns the copy, to be freed with
+// palloc_free_page(), or a null pointer if memory is short or the
+// string does not fit in a page.  Exits the process if the string
+// runs out of user memory.
+static char *
+copyInString (const char *ustr) {
+	char *kstr;
+	size_t i;
+
+	validateString (ustr);
+	kstr = palloc_get_page (0);
+	if (kstr == NULL)
+		return NULL;
+
+	for (i = 0; i < PGSIZE; i++) {
+		kstr[i] = ustr[i];
+		if (kstr[i] == '\0')
+			return kstr;
+	}
+	palloc_free_page (kstr);
+	return NULL;
+}
+
 static struct userFile_t *
 fileFromFid (int fid)
 {
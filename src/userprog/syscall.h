@@ -1,6 +1,14 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+#include <stdbool.h>
+
 void syscall_init (void);
+bool syscall_acquire_filesys (void);
+void syscall_release_filesys (bool acquired);
+#ifdef VM
+struct thread;
+bool syscall_copy_files (struct thread *parent);
+#endif
 
 #endif /* userprog/syscall.h */
@@ -0,0 +1,347 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <stdio.h>
+#include "vm/page.h"
+#include "devices/timer.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+
+/* Frame table.
+
+   At startup, the frame table takes every page in the user pool,
+   and from then on all user pages are frames handed out here.
+   When no frame is free, one is taken from some page using the
+   second-chance "clock" algorithm: the hand sweeps over the
+   frames, and passes over, but clears, the accessed bit of each
+   page that has been used since the hand last passed.  The first
+   page found that has not been used is evicted.
+
+   Each frame has a lock.  A frame's lock is held while its page
+   is being read in or written out, and for as long as a system
+   call needs the page to stay put, so the clock skips frames
+   whose lock is held.
+
+   A frame usually holds one process's page, but a page of a file
+   that several processes map is kept in a single frame that all
+   of them share.  Such frames are entered in `shared_frames',
+   keyed by file and offset, so that a process faulting on the
+   page can find the frame that others already have. */
+
+static struct frame *frames;
+static size_t frame_cnt;
+
+/* Protects the clock hand and the choice of a victim. */
+static struct lock scan_lock;
+static size_t hand;
+
+/* Where the search for a free frame starts.  Also protected by
+   scan_lock. */
+static size_t free_hand;
+
+/* Shared frames, and a lock that protects the table. */
+static struct hash shared_frames;
+static struct lock shared_lock;
+
+/* Statistics. */
+static long long evict_cnt;             /* Frames evicted. */
+static long long scan_cnt;              /* Frames examined by the clock. */
+static long long share_cnt;             /* Faults that found a shared frame. */
+
+static hash_hash_func shared_hash;
+static hash_less_func shared_less;
+static struct frame *find_free (void);
+static void remove_shared (struct frame *);
+
+/* Takes over the user pool as the frame table. */
+void
+frame_init (void)
+{
+  void *base;
+
+  lock_init (&scan_lock);
+  lock_init (&shared_lock);
+  if (!hash_init (&shared_frames, shared_hash, shared_less, NULL))
+    PANIC ("out of memory allocating shared frame table");
+
+  frames = malloc (sizeof *frames * ram_pages);
+  if (frames == NULL)
+    PANIC ("out of memory allocating page frames");
+
+  while ((base = palloc_get_page (PAL_USER)) != NULL)
+    {
+      struct frame *f = &frames[frame_cnt++];
+      lock_init (&f->lock);
+      f->base = base;
+      list_init (&f->pages);
+      f->dirty = false;
+      f->inode = NULL;
+    }
+}
+
+/* Tries once to allocate a frame, evicting the pages in another
+   frame if no frame is free.  Returns the frame, locked and
+   holding no pages, or a null pointer if every frame is locked or
+   eviction fails. */
+static struct frame *
+try_frame_alloc_and_lock (void)
+{
+  struct frame *f;
+  size_t i;
+
+  lock_acquire (&scan_lock);
+
+  /* Find a free frame. */
+  f = find_free ();
+  if (f != NULL)
+    {
+      lock_release (&scan_lock);
+      return f;
+    }
+
+  /* No free frame.  Sweep the clock hand around at most twice,
+     since the first pass may only clear accessed bits. */
+  for (i = 0; i < frame_cnt * 2; i++)
+    {
+      f = &frames[hand];
+      if (++hand >= frame_cnt)
+        hand = 0;
+      scan_cnt++;
+
+      if (!lock_try_acquire (&f->lock))
+        continue;
+
+      if (list_empty (&f->pages))
+        {
+          lock_release (&scan_lock);
+          f->dirty = false;
+          return f;
+        }
+
+      if (page_accessed_recently (f))
+        {
+          lock_release (&f->lock);
+          continue;
+        }
+
+      /* Evict this frame's pages.  The victim is chosen, so let
+         other threads scan while it is written out. */
+      lock_release (&scan_lock);
+      if (!page_out (f))
+        {
+          lock_release (&f->lock);
+          return NULL;
+        }
+      remove_shared (f);
+      evict_cnt++;
+      f->dirty = false;
+      return f;
+    }
+
+  lock_release (&scan_lock);
+  return NULL;
+}
+
+/* Allocates a frame and returns it, locked and holding no pages.
+   Returns a null pointer if no frame can be freed, even after
+   waiting a little for other threads to unlock theirs. */
+struct frame *
+frame_alloc_and_lock (void)
+{
+  size_t try;
+
+  for (try = 0; try < 3; try++)
+    {
+      struct frame *f = try_frame_alloc_and_lock ();
+      if (f != NULL)
+        {
+          ASSERT (lock_held_by_current_thread (&f->lock));
+          return f;
+        }
+      timer_msleep (1000);
+    }
+  return NULL;
+}
+
+/* Returns a free frame, locked and holding no pages, without
+   evicting any page, or a null pointer if no frame is free. */
+struct frame *
+frame_alloc_free_and_lock (void)
+{
+  struct frame *f;
+
+  lock_acquire (&scan_lock);
+  f = find_free ();
+  lock_release (&scan_lock);
+  return f;
+}
+
+/* Locks PAGE's frame, if it has one, so that it stays in memory
+   until frame_unlock().  PAGE may lose its frame while this waits
+   for the lock, in which case PAGE->frame is null on return. */
+void
+frame_lock (struct page *page)
+{
+  struct frame *f = page->frame;
+  if (f != NULL)
+    {
+      lock_acquire (&f->lock);
+      if (f != page->frame)
+        {
+          lock_release (&f->lock);
+          ASSERT (page->frame == NULL);
+        }
+    }
+}
+
+/* Unlocks frame F, which the running thread must have locked. */
+void
+frame_unlock (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  lock_release (&f->lock);
+}
+
+/* Releases frame F, which the running thread must have locked
+   and which must hold no pages, for other use. */
+void
+frame_free (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (list_empty (&f->pages));
+  remove_shared (f);
+  lock_release (&f->lock);
+}
+
+/* Returns the shared frame that holds READ_BYTES bytes of the
+   file with INODE, starting at offset OFS, followed by zeros,
+   locked, or a null pointer if there is none. */
+struct frame *
+frame_find_shared (struct inode *inode, off_t ofs, size_t read_bytes)
+{
+  struct frame key;
+
+  key.inode = inode;
+  key.ofs = ofs;
+  key.read_bytes = read_bytes;
+  for (;;)
+    {
+      struct hash_elem *e;
+      struct frame *f;
+
+      lock_acquire (&shared_lock);
+      e = hash_find (&shared_frames, &key.hash_elem);
+      lock_release (&shared_lock);
+      if (e == NULL)
+        return NULL;
+
+      /* The frame may be evicted while this waits for its lock,
+         so check that it still holds the same data. */
+      f = hash_entry (e, struct frame, hash_elem);
+      lock_acquire (&f->lock);
+      if (f->inode == inode && f->ofs == ofs && f->read_bytes == read_bytes)
+        {
+          share_cnt++;
+          return f;
+        }
+      lock_release (&f->lock);
+    }
+}
+
+/* Enters frame F, which the running thread must have locked and
+   which holds READ_BYTES bytes of the file with INODE starting at
+   offset OFS, followed by zeros, as a shared frame.  Returns true
+   if successful, false if another frame already holds the same
+   data. */
+bool
+frame_add_shared (struct frame *f, struct inode *inode, off_t ofs,
+                  size_t read_bytes)
+{
+  bool success;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (f->inode == NULL);
+
+  f->inode = inode;
+  f->ofs = ofs;
+  f->read_bytes = read_bytes;
+  lock_acquire (&shared_lock);
+  success = hash_insert (&shared_frames, &f->hash_elem) == NULL;
+  lock_release (&shared_lock);
+  if (!success)
+    f->inode = NULL;
+  return success;
+}
+
+/* Prints frame table statistics. */
+void
+frame_print_stats (void)
+{
+  printf ("Frames: %zu user frames, %lld evictions, %lld clock steps, "
+          "%lld shared faults\n",
+          frame_cnt, evict_cnt, scan_cnt, share_cnt);
+}
+
+/* Returns a free frame, locked, or a null pointer if there is
+   none.  scan_lock must be held. */
+static struct frame *
+find_free (void)
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&scan_lock));
+
+  for (i = 0; i < frame_cnt; i++)
+    {
+      struct frame *f = &frames[free_hand];
+      if (++free_hand >= frame_cnt)
+        free_hand = 0;
+
+      if (!lock_try_acquire (&f->lock))
+        continue;
+      if (list_empty (&f->pages))
+        {
+          f->dirty = false;
+          return f;
+        }
+      lock_release (&f->lock);
+    }
+  return NULL;
+}
+
+/* Removes frame F, which the running thread must have locked,
+   from the shared frames, if it is there. */
+static void
+remove_shared (struct frame *f)
+{
+  if (f->inode != NULL)
+    {
+      lock_acquire (&shared_lock);
+      hash_delete (&shared_frames, &f->hash_elem);
+      lock_release (&shared_lock);
+      f->inode = NULL;
+    }
+}
+
+/* Returns a hash value for shared frame E. */
+static unsigned
+shared_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct frame *f = hash_entry (e, struct frame, hash_elem);
+  return hash_bytes (&f->inode, sizeof f->inode) ^ hash_int (f->ofs);
+}
+
+/* Returns true if shared frame A precedes B. */
+static bool
+shared_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED)
+{
+  const struct frame *a = hash_entry (a_, struct frame, hash_elem);
+  const struct frame *b = hash_entry (b_, struct frame, hash_elem);
+
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  if (a->ofs != b->ofs)
+    return a->ofs < b->ofs;
+  return a->read_bytes < b->read_bytes;
+}
@@ -0,0 +1,43 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+struct inode;
+struct page;
+
+/* A physical frame in the user pool. */
+struct frame
+  {
+    struct lock lock;                   /* Held while in use or changing. */
+    void *base;                         /* Kernel virtual base address. */
+    struct list pages;                  /* Pages mapping it; empty if free. */
+    bool dirty;                         /* Modified through a page since
+                                           unmapped? */
+
+    /* A frame shared by every page that maps the same part of a
+       file is entered in the table of shared frames. */
+    struct hash_elem hash_elem;         /* Element in `shared_frames'. */
+    struct inode *inode;                /* File's inode, or null. */
+    off_t ofs;                          /* Offset in file. */
+    size_t read_bytes;                  /* Bytes from file; rest zero. */
+  };
+
+void frame_init (void);
+struct frame *frame_alloc_and_lock (void);
+struct frame *frame_alloc_free_and_lock (void);
+void frame_lock (struct page *);
+void frame_unlock (struct frame *);
+void frame_free (struct frame *);
+struct frame *frame_find_shared (struct inode *, off_t ofs,
+                                 size_t read_bytes);
+bool frame_add_shared (struct frame *, struct inode *, off_t ofs,
+                       size_t read_bytes);
+void frame_print_stats (void);
+
+#endif /* vm/frame.h */
@@ -0,0 +1,188 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include "vm/page.h"
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/syscall.h"
+
+/* Memory-mapped files.
+
+   Mapping a file adds a shared page to the process's page table
+   for each page of the file, so that the file is read in as the
+   process touches it.  Modified pages are written back to the
+   file when they are evicted, when the mapping is removed, or
+   when the process exits, and processes that map the same part
+   of a file share its frame (see page.c). */
+
+/* A memory-mapped file. */
+struct mapping
+  {
+    struct list_elem elem;              /* Element in thread's `mappings'. */
+    int id;                             /* Mapping identifier. */
+    struct file *file;                  /* File, reopened for the mapping. */
+    uint8_t *base;                      /* Start of mapping. */
+    off_t length;                       /* File length when mapped. */
+    size_t page_cnt;                    /* Number of pages mapped. */
+  };
+
+static bool add_pages (struct mapping *);
+static void unmap (struct mapping *);
+
+/* Maps FILE into the running thread's address space starting at
+   ADDR.  The file system lock must be held.  Returns a mapping
+   identifier, or -1 if FILE is empty, if ADDR is null or not
+   page-aligned, if the pages at ADDR are not all free user pages
+   below the stack region, or if memory allocation fails. */
+int
+mmap_map (struct file *file, void *addr)
+{
+  struct thread *t = thread_current ();
+  uint8_t *stack_bottom = (uint8_t *) PHYS_BASE - t->stack_limit;
+  struct mapping *m;
+  off_t length;
+
+  length = file_length (file);
+  if (length == 0 || addr == NULL || pg_ofs (addr) != 0
+      || (uint8_t *) addr > stack_bottom
+      || (size_t) length > (size_t) (stack_bottom - (uint8_t *) addr))
+    return -1;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return -1;
+  m->file = file_reopen (file);
+  m->base = addr;
+  m->length = length;
+  if (m->file == NULL)
+    {
+      free (m);
+      return -1;
+    }
+  if (!add_pages (m))
+    return -1;
+
+  m->id = t->next_mapid++;
+  list_push_back (&t->mappings, &m->elem);
+  return m->id;
+}
+
+/* Gives the running thread a copy of each of PARENT's mappings,
+   with the same identifiers, for fork().  PARENT must not run
+   meanwhile.  Returns true if successful, false if memory
+   allocation fails. */
+bool
+mmap_copy (struct thread *parent)
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&parent->mappings); e != list_end (&parent->mappings);
+       e = list_next (e))
+    {
+      struct mapping *pm = list_entry (e, struct mapping, elem);
+      struct mapping *m = malloc (sizeof *m);
+      bool locked;
+
+      if (m == NULL)
+        return false;
+      locked = syscall_acquire_filesys ();
+      m->file = file_reopen (pm->file);
+      syscall_release_filesys (locked);
+      m->base = pm->base;
+      m->length = pm->length;
+      if (m->file == NULL)
+        {
+          free (m);
+          return false;
+        }
+      if (!add_pages (m))
+        return false;
+
+      m->id = pm->id;
+      list_push_back (&t->mappings, &m->elem);
+    }
+  t->next_mapid = parent->next_mapid;
+  return true;
+}
+
+/* Removes the running thread's mapping MAPID, writing modified
+   pages back to the file.  Returns true if successful, false if
+   there is no such mapping. */
+bool
+mmap_unmap (int mapid)
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&t->mappings); e != list_end (&t->mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->id == mapid)
+        {
+          list_remove (&m->elem);
+          unmap (m);
+          return true;
+        }
+    }
+  return false;
+}
+
+/* Removes all of the running thread's mappings. */
+void
+mmap_unmap_all (void)
+{
+  struct thread *t = thread_current ();
+
+  while (!list_empty (&t->mappings))
+    unmap (list_entry (list_pop_front (&t->mappings), struct mapping, elem));
+}
+
+/* Adds the pages of mapping M to the running thread's page
+   table, and sets M's page count.  Returns true if successful.
+   On failure, which happens if the pages are not all free user
+   pages or if memory allocation fails, frees M and returns
+   false. */
+static bool
+add_pages (struct mapping *m)
+{
+  size_t page_cnt = DIV_ROUND_UP (m->length, PGSIZE);
+
+  for (m->page_cnt = 0; m->page_cnt < page_cnt; m->page_cnt++)
+    {
+      uint8_t *upage = m->base + m->page_cnt * PGSIZE;
+      off_t ofs = m->page_cnt * PGSIZE;
+      size_t read_bytes = (m->length - ofs < PGSIZE
+                           ? (size_t) (m->length - ofs) : PGSIZE);
+
+      if (!is_user_vaddr (upage + PGSIZE - 1)
+          || page_lookup (upage) != NULL
+          || !page_add (upage, m->file, ofs, read_bytes, true, true))
+        {
+          /* Undo the pages added so far. */
+          unmap (m);
+          return false;
+        }
+    }
+  return true;
+}
+
+/* Removes M's pages, closes its file, and frees M. */
+static void
+unmap (struct mapping *m)
+{
+  size_t i;
+  bool locked;
+
+  for (i = 0; i < m->page_cnt; i++)
+    page_remove (m->base + i * PGSIZE);
+
+  locked = syscall_acquire_filesys ();
+  file_close (m->file);
+  syscall_release_filesys (locked);
+  free (m);
+}
@@ -0,0 +1,733 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/syscall.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* Demand paging.
+
+   Loading an executable only records, for each page of each of
+   its segments, where the page's contents come from.  Nothing is
+   read or allocated until the process first touches the page,
+   at which point the page fault handler calls page_in() to
+   allocate a frame, fill it from the file or with zeros, and map
+   it.  Pages that a process never touches cost it only their
+   entry in the supplemental page table.
+
+   When memory runs short, the frame table evicts frames with
+   page_out().  A private page that still matches its initial
+   contents is simply dropped, to be read in again from its file
+   or zeroed on the next fault.  Any other private page is
+   written to swap.
+
+   A shared page is a page of a file that every process mapping
+   the same part of the file sees in the same frame, as for
+   memory-mapped files and for the read-only pages, such as code,
+   of executables.  Its frame is found through the frame table's
+   shared frames, and all the pages mapping it are listed in the
+   frame, so that N processes running one program need only one
+   copy of its code.  The frame is freed only when its last page
+   is removed or when it is evicted, which unmaps every page.  A
+   modified shared frame is written back to the file then; a
+   frame whose pages are all read-only is never modified, so it
+   is simply dropped.
+
+   fork() gives the child a copy of each private page of its
+   parent that shares the parent's frame or swap slot, so that
+   forking costs time in proportion to the number of pages, not
+   their size.  While a frame has more than one private page, all
+   of them are mapped read-only, and a process that writes to one
+   faults and gets a copy of the frame to itself (see unshare()).
+   The list of pages in a frame doubles as its reference count:
+   the last page left in a frame owns it and maps it writable.
+
+   A process starts out with a single page of stack.  The stack
+   grows a page at a time as the process touches the pages below
+   it: an access to a page that is not in the page table adds a
+   zeroed page there, as long as the access is in the top
+   `stack_limit' bytes of user memory and at most 32 bytes below
+   the stack pointer, as PUSHA may fault.  Faults in system calls
+   go by the stack pointer that the process had on entry to the
+   kernel.
+
+   A process that runs through its code or a mapped file in order
+   would fault once per page.  So when a page read from a file
+   faults, page_in() also maps the other pages of the file in the
+   same aligned window of FAULT_AROUND_PAGES pages, if they are
+   already in memory or a free frame is available to read them
+   into.  Memory is never reclaimed for this: when no frame is
+   free, only the faulting page is brought in.
+
+   A page that starts out all zeros, such as a page of BSS or of
+   stack, needs no frame of its own until it is written.  Reading
+   it first maps the single, read-only zero page, outside the
+   frame table, and leaves the page without a frame.  The first
+   write then faults as for a page shared copy-on-write, and
+   page_in() gives the page a frame of its own. */
+
+/* Size of the window that page_in() maps around a fault on a page
+   read from a file, in pages.  Must be a power of 2. */
+#define FAULT_AROUND_PAGES 4
+
+/* Maximum stack size for new processes, in bytes. */
+size_t page_stack_limit = STACK_LIMIT_DEFAULT;
+
+/* A page of zeros, mapped read-only for pages that start out all
+   zeros until they are written. */
+static void *zero_page;
+
+/* Statistics. */
+static long long fault_cnt;             /* Faults handled by page_in(). */
+static long long around_cnt;            /* Pages mapped around a fault. */
+static long long zero_cnt;              /* Faults that mapped zero_page. */
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static hash_action_func page_destroy;
+static struct page *find_or_grow (const void *addr);
+static bool is_zero (const struct page *);
+static bool do_page_in (struct page *, bool evict);
+static void fault_around (struct page *);
+static bool unshare (struct page *);
+static bool map (struct page *);
+static void unmap (struct page *);
+static void release (struct page *);
+static void detach (struct page *);
+static bool write_back (struct page *, struct frame *);
+
+/* Sets up demand paging. */
+void
+page_init (void)
+{
+  zero_page = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+}
+
+/* Creates an empty supplemental page table for the running
+   thread.  Returns true if successful, false if memory is
+   short. */
+bool
+page_table_init (void)
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (t->pages == NULL);
+
+  list_init (&t->mappings);
+  t->stack_limit = page_stack_limit;
+  t->pages = malloc (sizeof *t->pages);
+  if (t->pages == NULL)
+    return false;
+  if (!hash_init (t->pages, page_hash, page_less, NULL))
+    {
+      free (t->pages);
+      t->pages = NULL;
+      return false;
+    }
+  return true;
+}
+
+/* Destroys the running thread's supplemental page table, if it
+   has one. */
+void
+page_table_destroy (void)
+{
+  struct thread *t = thread_current ();
+
+  if (t->pages != NULL)
+    {
+      hash_destroy (t->pages, page_destroy);
+      free (t->pages);
+      t->pages = NULL;
+    }
+}
+
+/* Copies PARENT's supplemental page table into the running
+   thread's, for fork().  PARENT must not run meanwhile.  Each
+   private page of PARENT's that is not yet in the running
+   thread's table is copied to share PARENT's frame or swap slot
+   copy-on-write, with PARENT's executable replaced by the running
+   thread's.  Returns true if successful, false if memory
+   allocation fails. */
+bool
+page_table_copy (struct thread *parent)
+{
+  struct thread *t = thread_current ();
+  struct hash_iterator i;
+
+  hash_first (&i, parent->pages);
+  while (hash_next (&i))
+    {
+      struct page *pp = hash_entry (hash_cur (&i), struct page, hash_elem);
+      struct file *file = pp->file;
+      struct page *p;
+
+      if (page_lookup (pp->addr) != NULL)
+        continue;
+      ASSERT (file == NULL || file == parent->exec_file);
+      if (file != NULL)
+        file = t->exec_file;
+      if (!page_add (pp->addr, file, pp->file_ofs, pp->read_bytes,
+                     pp->writable, pp->shared))
+        return false;
+      if (pp->shared)
+        continue;
+
+      p = page_lookup (pp->addr);
+      frame_lock (pp);
+      p->private = pp->private;
+      if (pp->frame != NULL)
+        {
+          struct frame *f = pp->frame;
+
+          /* PARENT faults on its next write and remaps the page
+             read-only, now that the frame is shared. */
+          if (pp->writable)
+            unmap (pp);
+          list_push_back (&f->pages, &p->frame_elem);
+          p->frame = f;
+          frame_unlock (f);
+        }
+      else if (pp->swap_sector != SWAP_NONE)
+        {
+          p->swap_sector = pp->swap_sector;
+          swap_share (p);
+        }
+    }
+  return true;
+}
+
+/* Adds a page at user virtual address UPAGE to the running
+   thread's supplemental page table.  When first touched, the
+   page will be filled with READ_BYTES bytes of FILE starting at
+   offset OFS, followed by zeros; FILE may be null if READ_BYTES
+   is 0.  The page will be writable by the process if WRITABLE is
+   true, read-only otherwise.  If SHARED is true, the page shares
+   its frame with every other shared page of the same part of
+   FILE, and changes to it are written back to FILE.  FILE must
+   stay open until the page is removed.
+   Returns true if successful, false if UPAGE is already in the
+   table or if memory allocation fails. */
+bool
+page_add (void *upage, struct file *file, off_t ofs, size_t read_bytes,
+          bool writable, bool shared)
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (read_bytes <= PGSIZE);
+  ASSERT (file != NULL || (read_bytes == 0 && !shared));
+
+  p = malloc (sizeof *p);
+  if (p == NULL)
+    return false;
+  p->addr = upage;
+  p->writable = writable;
+  p->shared = shared;
+  p->thread = t;
+  p->frame = NULL;
+  p->swap_sector = SWAP_NONE;
+  p->private = false;
+  p->file = file;
+  p->file_ofs = ofs;
+  p->read_bytes = read_bytes;
+
+  if (hash_insert (t->pages, &p->hash_elem) != NULL)
+    {
+      free (p);
+      return false;
+    }
+  return true;
+}
+
+/* Removes the running thread's page at UPAGE, which must exist,
+   writing it back to its file first if it is the last page of a
+   modified shared frame. */
+void
+page_remove (void *upage)
+{
+  struct thread *t = thread_current ();
+  struct page *p = page_lookup (upage);
+
+  ASSERT (p != NULL);
+  hash_delete (t->pages, &p->hash_elem);
+  release (p);
+}
+
+/* Returns the running thread's page that contains ADDR, or a
+   null pointer if there is none. */
+struct page *
+page_lookup (const void *addr)
+{
+  struct thread *t = thread_current ();
+  struct page key;
+  struct hash_elem *e;
+
+  if (t->pages == NULL)
+    return NULL;
+  key.addr = pg_round_down (addr);
+  e = hash_find (t->pages, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct page, hash_elem) : NULL;
+}
+
+/* Brings in the running thread's page that contains FAULT_ADDR,
+   if it is not in memory, and maps it.  If there is no such page
+   but FAULT_ADDR is a stack access, adds a new stack page.  If
+   WRITE is true, the fault was a write, so the page must be
+   writable, and a page that shares its frame copy-on-write gets
+   a copy of its own.
+   If the page is read from a file, nearby pages may be mapped as
+   well (see fault_around()).
+   A read of a page that is still all zeros maps the zero page.
+   Returns true if successful, false if there is no such page, if
+   WRITE is true and the page is read-only, or if memory or the
+   disk fails. */
+bool
+page_in (const void *fault_addr, bool write)
+{
+  struct page *p = find_or_grow (fault_addr);
+  bool success;
+
+  if (p == NULL || (write && !p->writable))
+    return false;
+
+  fault_cnt++;
+  frame_lock (p);
+  if (p->frame == NULL && !write && is_zero (p))
+    {
+      zero_cnt++;
+      return pagedir_set_page (p->thread->pagedir, p->addr, zero_page,
+                               false);
+    }
+  if (p->frame == NULL && !do_page_in (p, true))
+    return false;
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+
+  success = (!write || unshare (p)) && map (p);
+  frame_unlock (p->frame);
+  if (success && p->file != NULL)
+    fault_around (p);
+  return success;
+}
+
+/* Evicts the pages in frame F, which the running thread must have
+   locked.  Unmaps them, then writes a modified shared frame back
+   to its file and a private page to swap, unless it still
+   matches its initial contents and can simply be dropped.
+   Returns true if successful, in which case F holds no pages, or
+   false if swap is full or the file cannot be written. */
+bool
+page_out (struct frame *f)
+{
+  struct page *p;
+  struct list_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (!list_empty (&f->pages));
+
+  /* Unmap the pages first, so that their processes fault, and
+     wait for the frame, rather than modifying it while it is
+     being written out. */
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    unmap (list_entry (e, struct page, frame_elem));
+
+  p = list_entry (list_front (&f->pages), struct page, frame_elem);
+  if (p->shared)
+    {
+      if (f->dirty && !write_back (p, f))
+        return false;
+    }
+  else
+    {
+      /* Private pages that share a frame were copied from one
+         another by fork() and have the same contents. */
+      bool private = f->dirty || p->private;
+      if (private && !swap_out (f))
+        return false;
+      for (e = list_begin (&f->pages); e != list_end (&f->pages);
+           e = list_next (e))
+        list_entry (e, struct page, frame_elem)->private = private;
+    }
+
+  while (!list_empty (&f->pages))
+    {
+      p = list_entry (list_pop_front (&f->pages), struct page, frame_elem);
+      p->frame = NULL;
+    }
+  return true;
+}
+
+/* Returns true if any page in frame F, which the running thread
+   must have locked, has been accessed since the last call for F,
+   and clears their accessed bits. */
+bool
+page_accessed_recently (struct frame *f)
+{
+  struct list_elem *e;
+  bool accessed = false;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      uint32_t *pd = p->thread->pagedir;
+
+      if (pagedir_is_accessed (pd, p->addr))
+        {
+          pagedir_set_accessed (pd, p->addr, false);
+          accessed = true;
+        }
+    }
+  return accessed;
+}
+
+/* Brings in and locks every page of the running thread that
+   overlaps the SIZE bytes starting at ADDR, so that they stay in
+   memory until page_unlock().  System calls do this for user
+   buffers before taking the file system lock and handing the
+   buffers to the file system.  Otherwise the file system could
+   fault on a buffer while holding its own locks, and bringing the
+   page in could need those same locks, to read the page from a
+   file or to write back the frame it evicts.  If WILL_WRITE is
+   true, the pages must be writable, and pages shared
+   copy-on-write are copied first.
+   Returns true if successful, false if part of the range is not
+   in the process's address space or cannot be brought in.  Stack
+   pages in the range are added as page_in() would. */
+bool
+page_lock (const void *addr, size_t size, bool will_write)
+{
+  const uint8_t *first = pg_round_down (addr);
+  const uint8_t *last = (const uint8_t *) addr + (size > 0 ? size - 1 : 0);
+  const uint8_t *upage;
+
+  for (upage = first; upage <= last; upage += PGSIZE)
+    {
+      struct page *p = find_or_grow (upage);
+
+      if (!is_user_vaddr (upage) || p == NULL || (will_write && !p->writable))
+        goto fail;
+      frame_lock (p);
+      if (p->frame == NULL && !do_page_in (p, true))
+        goto fail;
+      if ((will_write && !unshare (p)) || !map (p))
+        {
+          frame_unlock (p->frame);
+          goto fail;
+        }
+    }
+  return true;
+
+ fail:
+  if (upage > first)
+    page_unlock (first, upage - first);
+  return false;
+}
+
+/* Unlocks the pages locked by page_lock (ADDR, SIZE, ...). */
+void
+page_unlock (const void *addr, size_t size)
+{
+  const uint8_t *last = (const uint8_t *) addr + (size > 0 ? size - 1 : 0);
+  const uint8_t *upage;
+
+  for (upage = pg_round_down (addr); upage <= last; upage += PGSIZE)
+    {
+      struct page *p = page_lookup (upage);
+      ASSERT (p != NULL && p->frame != NULL);
+      frame_unlock (p->frame);
+    }
+}
+
+/* Returns the running thread's page that contains ADDR.  If
+   there is none, but ADDR is in the running thread's stack region
+   and no more than 32 bytes below its user stack pointer, adds a
+   zeroed page for it and returns that.  Otherwise, or if memory
+   allocation fails, returns a null pointer. */
+static struct page *
+find_or_grow (const void *addr)
+{
+  struct thread *t = thread_current ();
+  struct page *p = page_lookup (addr);
+  const uint8_t *a = addr;
+
+  if (p == NULL
+      && a < (uint8_t *) PHYS_BASE
+      && a >= (uint8_t *) PHYS_BASE - t->stack_limit
+      && a + 32 >= (uint8_t *) t->user_esp
+      && page_add (pg_round_down (addr), NULL, 0, 0, true, false))
+    p = page_lookup (addr);
+  return p;
+}
+
+/* Prints paging statistics. */
+void
+page_print_stats (void)
+{
+  printf ("Paging: %lld faults, %lld pages mapped around faults, "
+          "%lld zero page mappings\n",
+          fault_cnt, around_cnt, zero_cnt);
+}
+
+/* Returns true if page P, which must not have a frame, is all
+   zeros. */
+static bool
+is_zero (const struct page *p)
+{
+  return p->read_bytes == 0 && !p->private && p->swap_sector == SWAP_NONE;
+}
+
+/* Gives page P, which must not have a frame, a frame holding its
+   contents: the frame of the same part of the file, if P is
+   shared and another page has it in memory, or else a new frame
+   filled from swap, from P's file, or with zeros.  The new frame
+   may be taken from other pages if EVICT is true; otherwise only
+   a free frame is used.  Returns true if successful, with the
+   frame locked, or false on failure. */
+static bool
+do_page_in (struct page *p, bool evict)
+{
+  struct inode *inode = p->shared ? file_get_inode (p->file) : NULL;
+  struct frame *f;
+
+  for (;;)
+    {
+      if (p->shared)
+        {
+          f = frame_find_shared (inode, p->file_ofs, p->read_bytes);
+          if (f != NULL)
+            break;
+        }
+
+      f = evict ? frame_alloc_and_lock () : frame_alloc_free_and_lock ();
+      if (f == NULL)
+        return false;
+
+      if (p->swap_sector != SWAP_NONE)
+        {
+          bool success;
+
+          p->frame = f;
+          success = swap_in (p);
+          p->frame = NULL;
+          if (!success)
+            {
+              frame_free (f);
+              return false;
+            }
+        }
+      else
+        {
+          if (p->read_bytes > 0)
+            {
+              bool locked = syscall_acquire_filesys ();
+              off_t n = file_read_at (p->file, f->base, p->read_bytes,
+                                      p->file_ofs);
+              syscall_release_filesys (locked);
+              if (n != (off_t) p->read_bytes)
+                {
+                  frame_free (f);
+                  return false;
+                }
+            }
+          memset ((uint8_t *) f->base + p->read_bytes, 0,
+                  PGSIZE - p->read_bytes);
+        }
+
+      /* If another page brought in the same part of the file
+         meanwhile, use its frame instead. */
+      if (!p->shared
+          || frame_add_shared (f, inode, p->file_ofs, p->read_bytes))
+        break;
+      frame_free (f);
+    }
+
+  list_push_back (&f->pages, &p->frame_elem);
+  p->frame = f;
+  return true;
+}
+
+/* Maps the pages read from files in the aligned window of
+   FAULT_AROUND_PAGES pages around page P, which has just been
+   brought in, that are not mapped yet.  Pages not in memory are
+   read in only if they need not come from swap and a frame is
+   free. */
+static void
+fault_around (struct page *p)
+{
+  uint32_t *pd = p->thread->pagedir;
+  uint8_t *first = (uint8_t *) ((uintptr_t) p->addr
+                                & ~(FAULT_AROUND_PAGES * PGSIZE - 1));
+  int i;
+
+  for (i = 0; i < FAULT_AROUND_PAGES; i++)
+    {
+      struct page *q = page_lookup (first + i * PGSIZE);
+
+      if (q == NULL || q == p || q->file == NULL
+          || pagedir_get_page (pd, q->addr) != NULL)
+        continue;
+
+      frame_lock (q);
+      if (q->frame == NULL
+          && (q->swap_sector != SWAP_NONE || !do_page_in (q, false)))
+        continue;
+      if (map (q))
+        around_cnt++;
+      frame_unlock (q->frame);
+    }
+}
+
+/* Frees page P, which is no longer in its thread's page table,
+   along with its share of its frame or its swap slot. */
+static void
+release (struct page *p)
+{
+  frame_lock (p);
+  if (p->frame != NULL)
+    detach (p);
+  else
+    pagedir_clear_page (p->thread->pagedir, p->addr);
+  swap_release (p);
+  free (p);
+}
+
+/* Unmaps page P from its frame, which the running thread must
+   have locked, and unlocks the frame.  If P was the frame's last
+   page, frees the frame, first writing it back to P's file if P
+   is shared and the frame was modified. */
+static void
+detach (struct page *p)
+{
+  struct frame *f = p->frame;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  unmap (p);
+  list_remove (&p->frame_elem);
+  p->frame = NULL;
+
+  if (!list_empty (&f->pages))
+    frame_unlock (f);
+  else
+    {
+      if (p->shared && f->dirty)
+        write_back (p, f);
+      frame_free (f);
+    }
+}
+
+/* Makes private page P, whose frame the running thread must have
+   locked, the only page in its frame, by moving it to a copy of
+   the frame if the frame has other pages.  Returns true if
+   successful, with P's frame locked, or false if no frame is
+   available for the copy. */
+static bool
+unshare (struct page *p)
+{
+  struct frame *f = p->frame;
+  struct frame *copy;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  if (p->shared || list_front (&f->pages) == list_back (&f->pages))
+    return true;
+
+  copy = frame_alloc_and_lock ();
+  if (copy == NULL)
+    return false;
+  memcpy (copy->base, f->base, PGSIZE);
+
+  unmap (p);
+  list_remove (&p->frame_elem);
+  if (f->dirty)
+    p->private = true;
+  list_push_back (&copy->pages, &p->frame_elem);
+  p->frame = copy;
+  frame_unlock (f);
+  return true;
+}
+
+/* Maps page P into its thread's page directory, replacing any
+   existing mapping, writable if P is writable and no other
+   private page shares its frame, which the running thread must
+   have locked.  Returns true if successful, false if memory for
+   a page table is short. */
+static bool
+map (struct page *p)
+{
+  struct frame *f = p->frame;
+  bool writable = p->writable
+                  && (p->shared
+                      || list_front (&f->pages) == list_back (&f->pages));
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  unmap (p);
+  return pagedir_set_page (p->thread->pagedir, p->addr, f->base, writable);
+}
+
+/* Removes page P's mapping, if any, from its thread's page
+   directory.  Clearing the mapping loses its dirty bit, so P's
+   frame, which the running thread must have locked, remembers
+   it. */
+static void
+unmap (struct page *p)
+{
+  uint32_t *pd = p->thread->pagedir;
+
+  if (pagedir_is_dirty (pd, p->addr))
+    p->frame->dirty = true;
+  pagedir_clear_page (pd, p->addr);
+}
+
+/* Writes the part of frame F that shared page P maps from its
+   file back to the file.  Returns true if successful, false if
+   the write falls short. */
+static bool
+write_back (struct page *p, struct frame *f)
+{
+  bool locked = syscall_acquire_filesys ();
+  off_t n = file_write_at (p->file, f->base, p->read_bytes, p->file_ofs);
+  syscall_release_filesys (locked);
+  if (n != (off_t) p->read_bytes)
+    return false;
+  f->dirty = false;
+  return true;
+}
+
+/* Returns a hash value for page E. */
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (e, struct page, hash_elem);
+  return hash_int ((uintptr_t) p->addr >> PGBITS);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct page *a = hash_entry (a_, struct page, hash_elem);
+  const struct page *b = hash_entry (b_, struct page, hash_elem);
+  return a->addr < b->addr;
+}
+
+/* Frees page E, along with its frame or swap slot. */
+static void
+page_destroy (struct hash_elem *e, void *aux UNUSED)
+{
+  release (hash_entry (e, struct page, hash_elem));
+}
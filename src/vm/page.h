@@ -0,0 +1,68 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "devices/disk.h"
+
+struct file;
+struct frame;
+struct thread;
+
+/* Default maximum size of a process's stack, in bytes. */
+#define STACK_LIMIT_DEFAULT (8 * 1024 * 1024)
+
+/* No swap slot. */
+#define SWAP_NONE ((disk_sector_t) -1)
+
+/* A page of a process's virtual memory, as recorded in its
+   supplemental page table.  Besides the hardware page table,
+   which only knows about pages that are present, this records
+   where each page's contents come from, so that the page can
+   be brought in when it is first touched. */
+struct page
+  {
+    struct hash_elem hash_elem;         /* Element in thread's `pages'. */
+    void *addr;                         /* User virtual address. */
+    bool writable;                      /* Writable by the process? */
+    bool shared;                        /* Shared with other mappings? */
+    struct thread *thread;              /* Owning thread. */
+
+    /* Where the page is now.  FRAME and FRAME_ELEM are protected
+       by the frame's lock; see frame_lock(). */
+    struct frame *frame;                /* Frame, or null if not in memory. */
+    struct list_elem frame_elem;        /* Element in frame's `pages'. */
+    disk_sector_t swap_sector;          /* First swap sector, or SWAP_NONE. */
+    bool private;                       /* Differs from its initial contents? */
+
+    /* Initial contents: READ_BYTES bytes of FILE starting at
+       FILE_OFS, followed by zeros.  FILE is null for pages that
+       start out all zeros. */
+    struct file *file;                  /* File, or null. */
+    off_t file_ofs;                     /* Offset in FILE. */
+    size_t read_bytes;                  /* Bytes to read from FILE. */
+  };
+
+extern size_t page_stack_limit;
+
+void page_init (void);
+bool page_table_init (void);
+void page_table_destroy (void);
+bool page_table_copy (struct thread *parent);
+
+bool page_add (void *upage, struct file *, off_t ofs, size_t read_bytes,
+               bool writable, bool shared);
+void page_remove (void *upage);
+struct page *page_lookup (const void *addr);
+bool page_in (const void *fault_addr, bool write);
+bool page_out (struct frame *);
+bool page_accessed_recently (struct frame *);
+void page_print_stats (void);
+
+bool page_lock (const void *addr, size_t size, bool will_write);
+void page_unlock (const void *addr, size_t size);
+
+#endif /* vm/page.h */
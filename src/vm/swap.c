@@ -0,0 +1,464 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <lz.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "devices/disk.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Swap.
+
+   Pages that must be evicted but cannot be read back from a file
+   are written to the swap disk, hd1:1, in page-sized slots.  A
+   bitmap tracks which slots are in use.  A page keeps its slot
+   only while it is out of memory: swapping it in frees the slot,
+   and the page is written to a fresh slot the next time it is
+   evicted.
+
+   After fork(), a parent and child may share a frame
+   copy-on-write, and evicting the frame gives all of its pages
+   the same slot.  Each slot therefore counts the pages that
+   refer to it, and is freed when the last of them is swapped in
+   or released.
+
+   Writing pages one at a time, as they are evicted, would cost a
+   seek per page.  Instead, swap reserves a run of SWAP_CLUSTER
+   contiguous slots, or a shorter run if swap is too fragmented,
+   and copies evicted pages into a cluster buffer, assigning them
+   the run's slots in order.  Once the run is full, the whole
+   buffer goes to disk in a single request.  Until then, a page
+   whose slot is still in the buffer is swapped in from there.
+
+   Pages evicted together tend to be needed together, so reading a
+   slot from disk also reads the neighbouring slots, within the
+   same aligned group of SWAP_CLUSTER slots, that belong to the
+   same process.  These are kept in a read-around buffer, from
+   which later faults on them are served without going to disk.
+
+   In front of the disk is a pool of memory that holds pages
+   compressed.  An evicted page that compresses to at most
+   POOL_MAX_SIZE bytes is kept in the pool, if there is room,
+   still under a slot of its own but never written to disk.  Only
+   pages that do not compress well enough, or do not fit in the
+   pool, go to disk.  Pool memory is handed out in POOL_CHUNK-byte
+   chunks, with a bitmap tracking the chunks in use. */
+
+/* Number of sectors per page. */
+#define PAGE_SECTORS (PGSIZE / DISK_SECTOR_SIZE)
+
+/* Maximum number of slots written or read in one request. */
+#define SWAP_CLUSTER 8
+
+/* Unit of allocation in the compressed pool, in bytes. */
+#define POOL_CHUNK 128
+
+/* Largest compressed page kept in the pool, in bytes. */
+#define POOL_MAX_SIZE (PGSIZE * 3 / 4)
+
+/* Size of the compressed pool, in kB, or 0 for none. */
+size_t swap_pool_kb = 256;
+
+/* The swap disk. */
+static struct disk *swap_disk;
+
+/* Used swap slots. */
+static struct bitmap *swap_bitmap;
+
+/* Number of pages that refer to each slot. */
+static unsigned *swap_refs;
+
+/* Process whose page each slot holds. */
+static tid_t *swap_owner;
+
+/* Cluster being filled: OUT_SIZE slots starting at OUT_FIRST, of
+   which the first OUT_CNT are in OUT_BUF and not yet on disk. */
+static uint8_t *out_buf;
+static size_t out_first;
+static size_t out_size;
+static size_t out_cnt;
+
+/* Read-around buffer: RA_CNT slots starting at RA_FIRST, of which
+   those marked in RA_VALID are still current. */
+static uint8_t *ra_buf;
+static size_t ra_first;
+static size_t ra_cnt;
+static bool ra_valid[SWAP_CLUSTER];
+
+/* Compressed pool: POOL_PAGES pages at POOL, with the chunks in
+   use marked in POOL_MAP.  For each slot held in the pool, POOLED
+   gives its first chunk and its compressed size; the size is 0
+   for slots whose pages are on disk.  POOL_BUF is two pages: the
+   first for the compressor's output, the second for its work
+   area. */
+struct pooled
+  {
+    size_t first;                       /* First chunk. */
+    size_t size;                        /* Compressed size, or 0. */
+  };
+static uint8_t *pool;
+static size_t pool_pages;
+static struct bitmap *pool_map;
+static struct pooled *pooled;
+static uint8_t *pool_buf;
+
+/* Protects all of the above. */
+static struct lock swap_lock;
+
+/* Statistics. */
+static long long swap_out_cnt;          /* Pages written to swap. */
+static long long swap_in_cnt;           /* Pages read from swap. */
+static long long cluster_cnt[SWAP_CLUSTER + 1]; /* Writes, by size. */
+static long long ra_read_cnt;           /* Pages read around a fault. */
+static long long ra_hit_cnt;            /* Faults served by read-around. */
+static long long pool_out_cnt;          /* Pages compressed into the pool. */
+static long long pool_in_cnt;           /* Pages read from the pool. */
+static long long pool_full_cnt;         /* Pages not stored: pool full. */
+static long long pool_poor_cnt;         /* Pages not stored: incompressible. */
+static long long pool_bytes;            /* Compressed bytes in the pool. */
+static long long pool_bytes_out;        /* Compressed bytes ever stored. */
+
+static void pool_init (size_t slot_cnt);
+static bool pool_store (const void *page, size_t *slot);
+static bool reserve_run (void);
+static void flush (void);
+static bool is_pending (size_t slot);
+static void read_around (size_t slot, void *page);
+static void release_slot (size_t slot);
+
+/* Sets up swap. */
+void
+swap_init (void)
+{
+  size_t slot_cnt = 0;
+
+  swap_disk = disk_get (1, 1);
+  if (swap_disk == NULL)
+    printf ("no swap disk--swap disabled\n");
+  else
+    slot_cnt = disk_size (swap_disk) / PAGE_SECTORS;
+
+  swap_bitmap = bitmap_create (slot_cnt);
+  swap_refs = calloc (slot_cnt > 0 ? slot_cnt : 1, sizeof *swap_refs);
+  swap_owner = calloc (slot_cnt > 0 ? slot_cnt : 1, sizeof *swap_owner);
+  if (swap_bitmap == NULL || swap_refs == NULL || swap_owner == NULL)
+    PANIC ("couldn't create swap bitmap");
+  out_buf = palloc_get_multiple (PAL_ASSERT, SWAP_CLUSTER);
+  ra_buf = palloc_get_multiple (PAL_ASSERT, SWAP_CLUSTER);
+  pool_init (slot_cnt);
+  lock_init (&swap_lock);
+}
+
+/* Writes frame F, which the running thread must have locked, to
+   a free swap slot, and records the slot in each of F's pages.
+   Returns true if successful, false if swap is full. */
+bool
+swap_out (struct frame *f)
+{
+  struct page *p;
+  struct list_elem *e;
+  disk_sector_t sector;
+  size_t slot;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (!list_empty (&f->pages));
+
+  p = list_entry (list_front (&f->pages), struct page, frame_elem);
+  lock_acquire (&swap_lock);
+  if (!pool_store (f->base, &slot))
+    {
+      if (out_cnt == out_size && !reserve_run ())
+        {
+          lock_release (&swap_lock);
+          return false;
+        }
+      slot = out_first + out_cnt;
+      memcpy (out_buf + out_cnt * PGSIZE, f->base, PGSIZE);
+      if (++out_cnt == out_size)
+        flush ();
+    }
+  swap_refs[slot] = list_size (&f->pages);
+  swap_owner[slot] = p->thread->tid;
+  swap_out_cnt++;
+  lock_release (&swap_lock);
+
+  sector = slot * PAGE_SECTORS;
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    list_entry (e, struct page, frame_elem)->swap_sector = sector;
+  return true;
+}
+
+/* Reads PAGE from its swap slot into its frame, which the running
+   thread must have locked, and releases the slot.  Returns true
+   if successful, false if the page's compressed copy in the pool
+   turns out to be corrupt, in which case PAGE keeps its slot. */
+bool
+swap_in (struct page *p)
+{
+  size_t slot;
+
+  ASSERT (p->frame != NULL);
+  ASSERT (lock_held_by_current_thread (&p->frame->lock));
+  ASSERT (p->swap_sector != SWAP_NONE);
+
+  slot = p->swap_sector / PAGE_SECTORS;
+  lock_acquire (&swap_lock);
+  if (pooled[slot].size > 0)
+    {
+      if (lz_decompress (pool + pooled[slot].first * POOL_CHUNK,
+                         pooled[slot].size, p->frame->base, PGSIZE)
+          != PGSIZE)
+        {
+          lock_release (&swap_lock);
+          return false;
+        }
+      pool_in_cnt++;
+    }
+  else if (is_pending (slot))
+    memcpy (p->frame->base, out_buf + (slot - out_first) * PGSIZE, PGSIZE);
+  else if (slot >= ra_first && slot < ra_first + ra_cnt
+           && ra_valid[slot - ra_first])
+    {
+      memcpy (p->frame->base, ra_buf + (slot - ra_first) * PGSIZE, PGSIZE);
+      ra_hit_cnt++;
+    }
+  else
+    read_around (slot, p->frame->base);
+  swap_in_cnt++;
+  release_slot (slot);
+  lock_release (&swap_lock);
+  p->swap_sector = SWAP_NONE;
+  return true;
+}
+
+/* Gives page P, which has just been made a copy of a page in
+   swap, another reference to the copied page's slot. */
+void
+swap_share (struct page *p)
+{
+  ASSERT (p->swap_sector != SWAP_NONE);
+
+  lock_acquire (&swap_lock);
+  swap_refs[p->swap_sector / PAGE_SECTORS]++;
+  lock_release (&swap_lock);
+}
+
+/* Releases PAGE's swap slot, if it has one, freeing the slot if
+   no other page refers to it. */
+void
+swap_release (struct page *p)
+{
+  if (p->swap_sector != SWAP_NONE)
+    {
+      lock_acquire (&swap_lock);
+      release_slot (p->swap_sector / PAGE_SECTORS);
+      lock_release (&swap_lock);
+      p->swap_sector = SWAP_NONE;
+    }
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void)
+{
+  size_t i;
+
+  printf ("Swap: %zu of %zu slots in use, %lld pages out, %lld in, "
+          "%lld read around, %lld read-around hits\n",
+          bitmap_count (swap_bitmap, 0, bitmap_size (swap_bitmap), true),
+          bitmap_size (swap_bitmap), swap_out_cnt, swap_in_cnt,
+          ra_read_cnt, ra_hit_cnt);
+  printf ("Swap writes by cluster size:");
+  for (i = 1; i <= SWAP_CLUSTER; i++)
+    printf (" %zu:%lld", i, cluster_cnt[i]);
+  printf ("\n");
+  printf ("Swap pool: %lld of %zu kB in use, %lld pages in, "
+          "%lld out (%lld%% of swap-ins), compressed to %lld%%, "
+          "%lld turned away full, %lld incompressible\n",
+          pool_bytes / 1024, pool_pages * PGSIZE / 1024,
+          pool_out_cnt, pool_in_cnt,
+          swap_in_cnt > 0 ? pool_in_cnt * 100 / swap_in_cnt : 0,
+          pool_out_cnt > 0 ? pool_bytes_out * 100 / (pool_out_cnt * PGSIZE) : 0,
+          pool_full_cnt, pool_poor_cnt);
+}
+
+/* Sets up the compressed pool, with room to record SLOT_CNT
+   slots, taking as much of swap_pool_kb kB as the kernel pool can
+   spare. */
+static void
+pool_init (size_t slot_cnt)
+{
+  pooled = calloc (slot_cnt > 0 ? slot_cnt : 1, sizeof *pooled);
+  if (pooled == NULL)
+    PANIC ("couldn't create swap pool");
+  if (slot_cnt == 0)
+    return;
+
+  for (pool_pages = swap_pool_kb / (PGSIZE / 1024); pool_pages > 0;
+       pool_pages /= 2)
+    {
+      pool = palloc_get_multiple (0, pool_pages);
+      if (pool != NULL)
+        break;
+    }
+  if (pool_pages == 0)
+    return;
+
+  pool_map = bitmap_create (pool_pages * (PGSIZE / POOL_CHUNK));
+  pool_buf = palloc_get_multiple (0, 2);
+  if (pool_map == NULL || pool_buf == NULL)
+    PANIC ("couldn't create swap pool");
+}
+
+/* Tries to compress PAGE into the pool, under a new slot stored in
+   *SLOT.  Returns true if successful, false if the pool is
+   disabled or full, if PAGE does not compress well enough, or if
+   no slot is free. */
+static bool
+pool_store (const void *page, size_t *slot)
+{
+  size_t size, chunk_cnt, first;
+
+  if (pool_pages == 0)
+    return false;
+
+  size = lz_compress (page, PGSIZE, pool_buf, POOL_MAX_SIZE,
+                      pool_buf + PGSIZE);
+  if (size == 0)
+    {
+      pool_poor_cnt++;
+      return false;
+    }
+
+  chunk_cnt = DIV_ROUND_UP (size, POOL_CHUNK);
+  first = bitmap_scan_and_flip (pool_map, 0, chunk_cnt, false);
+  if (first == BITMAP_ERROR)
+    {
+      pool_full_cnt++;
+      return false;
+    }
+  *slot = bitmap_scan_and_flip (swap_bitmap, 0, 1, false);
+  if (*slot == BITMAP_ERROR)
+    {
+      bitmap_set_multiple (pool_map, first, chunk_cnt, false);
+      return false;
+    }
+
+  memcpy (pool + first * POOL_CHUNK, pool_buf, size);
+  pooled[*slot].first = first;
+  pooled[*slot].size = size;
+  pool_out_cnt++;
+  pool_bytes += size;
+  pool_bytes_out += size;
+  return true;
+}
+
+/* Reserves a run of free slots for the cluster buffer, as long as
+   SWAP_CLUSTER slots if possible.  Returns true if successful,
+   false if swap is full. */
+static bool
+reserve_run (void)
+{
+  size_t size;
+
+  ASSERT (out_cnt == out_size);
+
+  for (size = SWAP_CLUSTER; size > 0; size /= 2)
+    {
+      size_t first = bitmap_scan_and_flip (swap_bitmap, 0, size, false);
+      if (first != BITMAP_ERROR)
+        {
+          out_first = first;
+          out_size = size;
+          out_cnt = 0;
+          return true;
+        }
+    }
+  return false;
+}
+
+/* Writes the full cluster buffer to its run of slots. */
+static void
+flush (void)
+{
+  ASSERT (out_cnt == out_size && out_cnt > 0);
+
+  disk_write_sectors (swap_disk, out_first * PAGE_SECTORS,
+                      out_cnt * PAGE_SECTORS, out_buf);
+  cluster_cnt[out_cnt]++;
+}
+
+/* Returns true if SLOT's data is in the cluster buffer but not
+   yet on disk. */
+static bool
+is_pending (size_t slot)
+{
+  return out_cnt < out_size && slot >= out_first && slot < out_first + out_cnt;
+}
+
+/* Reads SLOT into PAGE, together with the slots around it that
+   hold pages of the same process, which go into the read-around
+   buffer. */
+static void
+read_around (size_t slot, void *page)
+{
+  size_t group = slot - slot % SWAP_CLUSTER;
+  size_t end = group + SWAP_CLUSTER;
+  size_t first, last, i;
+
+  if (end > bitmap_size (swap_bitmap))
+    end = bitmap_size (swap_bitmap);
+
+  for (first = slot; first > group; first--)
+    {
+      size_t s = first - 1;
+      if (swap_refs[s] == 0 || swap_owner[s] != swap_owner[slot]
+          || is_pending (s) || pooled[s].size > 0)
+        break;
+    }
+  for (last = slot; last + 1 < end; last++)
+    {
+      size_t s = last + 1;
+      if (swap_refs[s] == 0 || swap_owner[s] != swap_owner[slot]
+          || is_pending (s) || pooled[s].size > 0)
+        break;
+    }
+
+  ra_first = first;
+  ra_cnt = last - first + 1;
+  disk_read_sectors (swap_disk, first * PAGE_SECTORS,
+                     ra_cnt * PAGE_SECTORS, ra_buf);
+  for (i = 0; i < ra_cnt; i++)
+    ra_valid[i] = first + i != slot;
+  ra_read_cnt += ra_cnt - 1;
+  memcpy (page, ra_buf + (slot - first) * PGSIZE, PGSIZE);
+}
+
+/* Drops a reference to SLOT, freeing it if it was the last. */
+static void
+release_slot (size_t slot)
+{
+  ASSERT (swap_refs[slot] > 0);
+  if (--swap_refs[slot] == 0)
+    {
+      bitmap_reset (swap_bitmap, slot);
+      if (pooled[slot].size > 0)
+        {
+          bitmap_set_multiple (pool_map, pooled[slot].first,
+                               DIV_ROUND_UP (pooled[slot].size, POOL_CHUNK),
+                               false);
+          pool_bytes -= pooled[slot].size;
+          pooled[slot].size = 0;
+        }
+      if (slot >= ra_first && slot < ra_first + ra_cnt)
+        ra_valid[slot - ra_first] = false;
+    }
+}
@@ -0,0 +1,20 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stdbool.h>
+
+#include <stddef.h>
+
+struct frame;
+struct page;
+
+extern size_t swap_pool_kb;
+
+void swap_init (void);
+bool swap_out (struct frame *);
+bool swap_in (struct page *);
+void swap_share (struct page *);
+void swap_release (struct page *);
+void swap_print_stats (void);
+
+#endif /* vm/swap.h */